@@ -0,0 +1,82 @@
+/**
+ * @file broadcast.cpp
+ *
+ * Measures cost of a broadcast through the signal to 1, 10, 100 and 1000 waiting
+ * coroutines. Every awaiter of the broadcast is collected into a suspend_point, so
+ * the benchmark also reports count of heap allocations per broadcast.
+ */
+#include <cocls/async.h>
+#include <cocls/signal.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+static std::atomic<std::size_t> allocations = 0;
+
+void *operator new(std::size_t sz) {
+    ++allocations;
+    void *p = std::malloc(sz?sz:1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void operator delete(void *p) noexcept {std::free(p);}
+void operator delete(void *p, std::size_t) noexcept {std::free(p);}
+void *operator new[](std::size_t sz) {return operator new(sz);}
+void operator delete[](void *p) noexcept {std::free(p);}
+void operator delete[](void *p, std::size_t) noexcept {std::free(p);}
+
+cocls::async<void> listener(cocls::signal<int>::emitter em, std::size_t &counter) {
+    try {
+        while (true) {
+            counter += co_await em;
+        }
+    } catch (const cocls::await_canceled_exception &) {
+        //signal destroyed
+    }
+}
+
+void run_test(std::size_t waiters, std::size_t rounds) {
+    std::size_t counter = 0;
+    {
+        cocls::signal<int> sig;
+        for (std::size_t i = 0; i < waiters; i++) {
+            listener(sig.get_emitter(), counter).detach();
+        }
+        auto collector = sig.get_collector();
+        //warm up
+        for (std::size_t i = 0; i < 10; i++) collector(1);
+
+        auto allocs = allocations.load();
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < rounds; i++) {
+            collector(1);
+        }
+        auto end = std::chrono::steady_clock::now();
+        allocs = allocations.load() - allocs;
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        std::cout << std::setw(8) << waiters
+                  << std::setw(16) << static_cast<double>(ns) / rounds
+                  << std::setw(16) << static_cast<double>(ns) / (rounds * waiters)
+                  << std::setw(16) << static_cast<double>(allocs) / rounds
+                  << std::endl;
+    }
+    if (counter != waiters * (rounds + 10)) {
+        std::cerr << "Unexpected counter value: " << counter << std::endl;
+        std::exit(1);
+    }
+}
+
+int main() {
+    std::cout << std::setw(8) << "waiters"
+              << std::setw(16) << "ns/broadcast"
+              << std::setw(16) << "ns/waiter"
+              << std::setw(16) << "allocs/bcast" << std::endl;
+    run_test(1, 100000);
+    run_test(10, 100000);
+    run_test(100, 10000);
+    run_test(1000, 1000);
+}
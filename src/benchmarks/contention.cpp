@@ -0,0 +1,140 @@
+/**
+ * @file contention.cpp
+ *
+ * Measures cost of false sharing on contended objects. The benchmark is built twice,
+ * benchmark_contention uses default layout of classes and benchmark_contention_padded
+ * is compiled with COCLS_PAD_CONTENDED. Compare outputs of both programs.
+ *
+ * Tests:
+ *  - mutex/private - every thread locks its own mutex, mutexes are stored in an array
+ *  - mutex/shared - all threads lock the same mutex
+ *  - thread_pool - all threads enqueue empty tasks to the same pool
+ *  - limited_queue/private - every thread pushes and pops its own queue stored in an array
+ *  - limited_queue/shared - half of threads push and half of threads pop the same queue
+ */
+#include <cocls/mutex.h>
+#include <cocls/queue.h>
+#include <cocls/thread_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+template<typename Fn>
+void run_threads(unsigned int threads, Fn &&fn) {
+    std::vector<std::thread> thrs;
+    for (unsigned int i = 0; i < threads; i++) {
+        thrs.push_back(std::thread([&fn, i]{fn(i);}));
+    }
+    for (auto &t: thrs) t.join();
+}
+
+template<typename Fn>
+void measure(const std::string &name, unsigned int threads, std::size_t ops, Fn &&fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    std::cout << std::setw(24) << std::left << name << std::right
+              << std::setw(8) << threads
+              << std::setw(16) << static_cast<double>(ns) / ops
+              << std::endl;
+}
+
+void test_mutex_private(unsigned int threads, std::size_t rounds) {
+    auto mxs = std::make_unique<cocls::mutex[]>(threads);
+    measure("mutex/private", threads, rounds * threads, [&]{
+        run_threads(threads, [&](unsigned int idx) {
+            cocls::mutex &mx = mxs[idx];
+            for (std::size_t i = 0; i < rounds; i++) {
+                auto own = mx.try_lock();
+                own.release();
+            }
+        });
+    });
+}
+
+void test_mutex_shared(unsigned int threads, std::size_t rounds) {
+    cocls::mutex mx;
+    std::size_t counter = 0;
+    measure("mutex/shared", threads, rounds * threads, [&]{
+        run_threads(threads, [&](unsigned int) {
+            for (std::size_t i = 0; i < rounds; i++) {
+                cocls::mutex::ownership own(mx.lock());
+                ++counter;
+            }
+        });
+    });
+    if (counter != rounds * threads) {
+        std::cerr << "Unexpected counter value: " << counter << std::endl;
+        std::exit(1);
+    }
+}
+
+void test_thread_pool(unsigned int threads, std::size_t rounds) {
+    cocls::thread_pool pool(threads);
+    std::atomic<std::size_t> counter = 0;
+    std::size_t total = rounds * threads;
+    measure("thread_pool", threads, total, [&]{
+        run_threads(threads, [&](unsigned int) {
+            for (std::size_t i = 0; i < rounds; i++) {
+                pool.run_detached([&]{counter.fetch_add(1, std::memory_order_relaxed);});
+            }
+        });
+        while (counter.load(std::memory_order_relaxed) != total) std::this_thread::yield();
+    });
+}
+
+struct small_queue: cocls::limited_queue<int> {
+    small_queue():cocls::limited_queue<int>(16) {}
+};
+
+void test_queue_private(unsigned int threads, std::size_t rounds) {
+    auto qs = std::make_unique<small_queue[]>(threads);
+    measure("limited_queue/private", threads, rounds * threads, [&]{
+        run_threads(threads, [&](unsigned int idx) {
+            small_queue &q = qs[idx];
+            for (std::size_t i = 0; i < rounds; i++) {
+                q.push(static_cast<int>(i)).wait();
+                q.pop().wait();
+            }
+        });
+    });
+}
+
+void test_queue_shared(unsigned int threads, std::size_t rounds) {
+    small_queue q;
+    unsigned int producers = std::max(threads / 2, 1U);
+    measure("limited_queue/shared", producers * 2, rounds * producers, [&]{
+        run_threads(producers * 2, [&](unsigned int idx) {
+            if (idx < producers) {
+                for (std::size_t i = 0; i < rounds; i++) q.push(static_cast<int>(i)).wait();
+            } else {
+                for (std::size_t i = 0; i < rounds; i++) q.pop().wait();
+            }
+        });
+    });
+}
+
+int main() {
+    unsigned int threads = std::clamp(std::thread::hardware_concurrency(), 2U, 8U);
+#ifdef COCLS_PAD_CONTENDED
+    std::cout << "layout: padded (COCLS_PAD_CONTENDED)" << std::endl;
+#else
+    std::cout << "layout: default" << std::endl;
+#endif
+    std::cout << std::setw(24) << std::left << "test" << std::right
+              << std::setw(8) << "threads"
+              << std::setw(16) << "ns/op" << std::endl;
+    test_mutex_private(threads, 2000000);
+    test_mutex_shared(threads, 200000);
+    test_thread_pool(threads, 200000);
+    test_queue_private(threads, 500000);
+    test_queue_shared(threads, 200000);
+}
@@ -0,0 +1,86 @@
+/**
+ * @file resume_depth.cpp
+ *
+ * Measures cost of the resume trampoline (COCLS_MAX_RESUME_DEPTH). The benchmark is built
+ * twice, benchmark_resume_depth uses default limit and benchmark_resume_depth_unlimited
+ * is compiled with COCLS_MAX_RESUME_DEPTH=0. Compare outputs of both programs.
+ *
+ * Tests:
+ *  - shallow - resolve a promise which calls a callback, no nesting
+ *  - chain - each callback resolves next promise. The chain is short enough
+ *    to not overflow the stack without the limit
+ */
+#include <cocls/future.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+template<typename Fn>
+void measure(const std::string &name, std::size_t ops, Fn &&fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    std::cout << std::setw(16) << std::left << name << std::right
+              << std::setw(16) << static_cast<double>(ns) / ops
+              << std::endl;
+}
+
+class counting_awaiter: public cocls::awaiter {
+public:
+    counting_awaiter(std::size_t &counter) {
+        set_resume_fn([](cocls::awaiter *, void *ctx) noexcept -> cocls::suspend_point<void>{
+            ++*reinterpret_cast<std::size_t *>(ctx);
+            return {};
+        }, &counter);
+    }
+};
+
+void test_shallow(std::size_t rounds) {
+    std::size_t counter = 0;
+    measure("shallow", rounds, [&]{
+        for (std::size_t i = 0; i < rounds; i++) {
+            cocls::future<int> f;
+            auto p = f.get_promise();
+            counting_awaiter awt(counter);
+            f.subscribe(&awt);
+            p(static_cast<int>(i));
+        }
+    });
+    if (counter != rounds) {
+        std::cerr << "Unexpected counter value: " << counter << std::endl;
+        std::exit(1);
+    }
+}
+
+void test_chain(std::size_t length, std::size_t rounds) {
+    std::size_t called = 0;
+    measure("chain", length * rounds, [&]{
+        for (std::size_t r = 0; r < rounds; r++) {
+            std::vector<cocls::promise<int> > promises;
+            promises.reserve(length);
+            for (std::size_t i = 0; i < length; i++) {
+                promises.push_back(cocls::make_promise<int>([&, i](cocls::future<int> &) {
+                    ++called;
+                    if (i + 1 < length) promises[i + 1](0);
+                }));
+            }
+            promises[0](0);
+        }
+    });
+    if (called != length * rounds) {
+        std::cerr << "Unexpected count of calls: " << called << std::endl;
+        std::exit(1);
+    }
+}
+
+int main() {
+    std::cout << "COCLS_MAX_RESUME_DEPTH: " << COCLS_MAX_RESUME_DEPTH << std::endl;
+    std::cout << std::setw(16) << std::left << "test" << std::right
+              << std::setw(16) << "ns/op" << std::endl;
+    test_shallow(10000000);
+    test_chain(1000, 2000);
+}
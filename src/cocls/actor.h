@@ -0,0 +1,339 @@
+/**
+ * @file actor.h
+ *
+ * Actor with typed mailbox running in a thread pool
+ */
+#pragma once
+#ifndef SRC_cocls_ACTOR_H_
+#define SRC_cocls_ACTOR_H_
+
+#include "awaiter.h"
+#include "exceptions.h"
+#include "future.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace cocls {
+
+///Base class of an actor
+/**
+ * The actor owns a mailbox. Messages are processed by the function receive() one
+ * by one, so the state of the actor doesn't need any locking. The actor is activated
+ * in the thread pool when a message arrives to empty mailbox, the activation processes
+ * all pending messages, then the actor becomes idle.
+ *
+ * The mailbox is lock-free intrusive list (multiple producers, single consumer). Sending
+ * a message allocates single node which holds the message (and the promise of ask())
+ *
+ * The mailbox can be bounded. When it is full, try_send() fails and co_await send()
+ * suspends the sender until there is a space (backpressure).
+ *
+ * @tparam Msg type of message
+ * @tparam Reply type of reply, which is returned by the receive() and passed to the
+ * caller of ask()
+ *
+ * @code
+ * class counter: public actor<int, int> {
+ * public:
+ *     using actor<int, int>::actor;
+ * protected:
+ *     int _sum = 0;
+ *     int receive(int &&v) override {return _sum += v;}
+ * };
+ *
+ * counter c(pool);
+ * c.tell(10);
+ * int sum = co_await c.ask(5);
+ * @endcode
+ *
+ * @note the actor must not receive messages while it is destroyed. The destructor waits
+ * until the activation, which processed the last message, finishes
+ */
+template<typename Msg, typename Reply = void>
+class actor {
+public:
+
+    ///mailbox without limit
+    static constexpr std::size_t unbounded = std::numeric_limits<std::size_t>::max();
+
+    ///Construct the actor
+    /**
+     * @param pool thread pool which processes messages
+     * @param capacity capacity of the mailbox
+     */
+    explicit actor(thread_pool &pool, std::size_t capacity = unbounded)
+        :_pool(pool),_capacity(capacity?capacity:1) {}
+
+    actor(const actor &) = delete;
+    actor &operator=(const actor &) = delete;
+
+    virtual ~actor() {
+        //the reply of ask() is resolved before the activation finishes
+        while (_runs.load(std::memory_order_acquire)) std::this_thread::yield();
+        node *n = _head.load(std::memory_order_acquire);
+        while (n && n != doorman()) {
+            node *x = n;
+            n = n->_next;
+            delete static_cast<envelope *>(x);
+        }
+    }
+
+    ///Send message without waiting
+    /**
+     * @param msg message
+     * @retval true message has been sent
+     * @retval false mailbox is full
+     */
+    bool try_send(Msg &&msg) {
+        if (!reserve()) return false;
+        push(new envelope(std::move(msg)));
+        return true;
+    }
+
+    ///Send message without waiting, the mailbox is expected to have a space
+    /**
+     * Same as try_send(), intended for unbounded mailbox
+     * @param msg message
+     * @exception mailbox_full_exception the mailbox is full, the message has not
+     * been sent. Use try_send() or send() for bounded mailbox
+     */
+    void tell(Msg &&msg) {
+        if (!try_send(std::move(msg))) throw mailbox_full_exception();
+    }
+
+    ///Awaiter of send(), it suspends the sender while the mailbox is full
+    class send_awaiter: public awaiter {
+    public:
+        send_awaiter(actor &owner, Msg &&msg):_owner(owner),_msg(std::move(msg)) {}
+        send_awaiter(const send_awaiter &) = delete;
+        send_awaiter &operator=(const send_awaiter &) = delete;
+
+        bool await_ready() {
+            return _owner.try_send(std::move(_msg));
+        }
+        bool await_suspend(std::coroutine_handle<> h) {
+            set_handle(h);
+            return _owner.block_sender(this);
+        }
+        static constexpr void await_resume() noexcept {}
+
+        ///wait synchronously
+        void wait() {
+            if (await_ready()) return;
+            sync_awaiter awt;
+            _sync = &awt;
+            set_resume_fn(&wakeup_sync);
+            if (_owner.block_sender(this)) awt.wait_sync();
+        }
+
+    protected:
+        friend class actor;
+        actor &_owner;
+        Msg _msg;
+        sync_awaiter *_sync = nullptr;
+
+        static suspend_point<void> wakeup_sync(awaiter *me, void *) noexcept {
+            static_cast<send_awaiter *>(me)->_sync->wakeup();
+            return {};
+        }
+    };
+
+    ///Send message, wait for space in the mailbox
+    /**
+     * @param msg message
+     * @return awaitable object, co_await suspends the coroutine while the mailbox is full.
+     * You can call wait() to wait synchronously
+     */
+    send_awaiter send(Msg &&msg) {
+        return send_awaiter(*this, std::move(msg));
+    }
+
+    ///Send message and receive reply
+    /**
+     * @param msg message
+     * @return future with the reply. If the receive() throws an exception, the exception
+     * is passed to the future.
+     *
+     * @note ask() is not limited by capacity of the mailbox, as the caller waits for the reply.
+     * The message occupies space of the mailbox as any other message
+     */
+    future<Reply> ask(Msg &&msg) {
+        return [&](auto promise) {
+            _count.fetch_add(1, std::memory_order_seq_cst);
+            push(new envelope(std::move(msg), std::move(promise)));
+        };
+    }
+
+    ///Count of messages in the mailbox (including message being processed)
+    std::size_t get_pending() const {
+        return _count.load(std::memory_order_relaxed);
+    }
+
+protected:
+
+    ///Process message
+    /**
+     * @param msg message
+     * @return reply
+     */
+    virtual Reply receive(Msg &&msg) = 0;
+
+    ///Called when receive() throws an exception while processing message without reply
+    virtual void on_error(std::exception_ptr) noexcept {}
+
+    struct node {
+        node *_next = nullptr;
+    };
+
+    struct envelope: node {
+        Msg _msg;
+        std::optional<promise<Reply> > _reply;
+        envelope(Msg &&msg):_msg(std::move(msg)) {}
+        envelope(Msg &&msg, promise<Reply> &&p):_msg(std::move(msg)),_reply(std::move(p)) {}
+    };
+
+    thread_pool &_pool;
+    std::size_t _capacity;
+    //incoming messages (LIFO). nullptr - idle, doorman - active
+    std::atomic<node *> _head = nullptr;
+    //count of messages
+    std::atomic<std::size_t> _count = 0;
+    //count of blocked senders, changed under _mx
+    std::atomic<std::size_t> _blocked_count = 0;
+    //blocked senders (LIFO is reversed when taken)
+    std::mutex _mx;
+    awaiter *_blocked = nullptr;
+    awaiter **_blocked_tail = &_blocked;
+    //count of scheduled or running activations
+    std::atomic<unsigned int> _runs = 0;
+
+    //counts the activation in _runs until it is finished or dropped by stopped pool
+    class run_guard {
+    public:
+        run_guard(actor *owner):_owner(owner) {
+            _owner->_runs.fetch_add(1, std::memory_order_relaxed);
+        }
+        run_guard(run_guard &&other):_owner(std::exchange(other._owner, nullptr)) {}
+        run_guard &operator=(const run_guard &) = delete;
+        ~run_guard() {
+            //the actor can be destroyed from now
+            if (_owner) _owner->_runs.fetch_sub(1, std::memory_order_release);
+        }
+        actor *get() const {return _owner;}
+    protected:
+        actor *_owner;
+    };
+
+    static node *doorman() {
+        static node n;
+        return &n;
+    }
+
+    bool reserve() {
+        auto c = _count.load(std::memory_order_relaxed);
+        do {
+            if (c >= _capacity) return false;
+        } while (!_count.compare_exchange_weak(c, c + 1, std::memory_order_seq_cst));
+        return true;
+    }
+
+    void push(envelope *e) {
+        node *n = e;
+        n->_next = _head.load(std::memory_order_relaxed);
+        while (!_head.compare_exchange_weak(n->_next, n, std::memory_order_release, std::memory_order_relaxed));
+        if (n->_next == nullptr) {
+            _pool.run_detached([g = run_guard(this)]{g.get()->run();});
+        }
+    }
+
+    //register blocked sender, returns false if the message has been sent meanwhile
+    bool block_sender(send_awaiter *awt) {
+        std::lock_guard _(_mx);
+        _blocked_count.fetch_add(1, std::memory_order_seq_cst);
+        if (reserve()) {
+            _blocked_count.fetch_sub(1, std::memory_order_relaxed);
+            push(new envelope(std::move(awt->_msg)));
+            return false;
+        }
+        //FIFO list of blocked senders
+        awt->_next = nullptr;
+        *_blocked_tail = awt;
+        _blocked_tail = &awt->_next;
+        return true;
+    }
+
+    //called after a message has been processed
+    void release_slot() {
+        _count.fetch_sub(1, std::memory_order_seq_cst);
+        if (_blocked_count.load(std::memory_order_seq_cst) == 0) return;
+        send_awaiter *awt = nullptr;
+        {
+            std::lock_guard _(_mx);
+            if (!_blocked || !reserve()) return;
+            awt = static_cast<send_awaiter *>(_blocked);
+            _blocked = _blocked->_next;
+            if (!_blocked) _blocked_tail = &_blocked;
+            _blocked_count.fetch_sub(1, std::memory_order_relaxed);
+            push(new envelope(std::move(awt->_msg)));
+        }
+        //sender continues in the pool, the actor continues processing
+        _pool.resume(awt->resume());
+    }
+
+    void process(envelope *e) {
+        if (e->_reply) {
+            try {
+                if constexpr(std::is_void_v<Reply>) {
+                    receive(std::move(e->_msg));
+                    (*e->_reply)();
+                } else {
+                    (*e->_reply)(receive(std::move(e->_msg)));
+                }
+            } catch (...) {
+                (*e->_reply)(std::current_exception());
+            }
+        } else {
+            try {
+                receive(std::move(e->_msg));
+            } catch (...) {
+                on_error(std::current_exception());
+            }
+        }
+    }
+
+    //activation - processes all pending messages
+    void run() {
+        for (;;) {
+            node *req = _head.exchange(doorman(), std::memory_order_acquire);
+            node *fifo = nullptr;
+            while (req && req != doorman()) {
+                node *x = req;
+                req = req->_next;
+                x->_next = fifo;
+                fifo = x;
+            }
+            while (fifo) {
+                auto e = static_cast<envelope *>(fifo);
+                fifo = fifo->_next;
+                process(e);
+                delete e;
+                release_slot();
+            }
+            node *x = doorman();
+            if (_head.compare_exchange_strong(x, nullptr, std::memory_order_release)) return;
+        }
+    }
+};
+
+}
+
+#endif /* SRC_cocls_ACTOR_H_ */
@@ -10,13 +10,14 @@
 
 #include "coro_queue.h"
 #include "awaiter.h"
+#include "coro_registry.h"
+#include "resumption_policy.h"
 
 #include <cassert>
 namespace cocls {
 
 template<typename T> class future;
 template<typename T> class promise;
-template<typename T> class async_promise;
 
 
 ///Coroutine for run asynchronous operations, it can be used to construct future<>
@@ -25,16 +26,17 @@ template<typename T> class async_promise;
  * implement such future as coroutine. Just declare coroutine which
  * returns future_coro, this future object can be converted to future<T>
  *
- * @param T returned value, can be void
- * @param _Policy resumption policy - void means default policy
+ * @tparam T returned value, can be void
+ * @tparam Policy resumption policy, defines how coroutines awaiting the result
+ * are resumed. See namespace resumption_policy
  */
-template<typename T>
+template<typename T, typename Policy>
 class [[nodiscard]] async {
 public:
 
     friend class future<T>;
 
-    using promise_type = async_promise<T>;
+    using promise_type = async_promise<T, Policy>;
 
     async(std::coroutine_handle<promise_type> h):_h(h) {}
     async(async &&other):_h(std::exchange(other._h, {})) {}
@@ -140,7 +142,7 @@ protected:
         return h;
     }
     std::coroutine_handle<> start_promise(cocls::promise<T> &p) {
-        async_promise<T> &promise = _h.promise();
+        promise_type &promise = _h.promise();
         promise._future = p.claim();
         if (promise._future) {
             return start_coro();
@@ -173,14 +175,29 @@ public:
 };
 
 
-template<typename T>
-class async_promise: public coro_unified_return<T, async_promise<T> > {
+template<typename T, typename Policy>
+class async_promise: public coro_unified_return<T, async_promise<T, Policy> >,
+                     public coro_registry_hook<coro_type::async> {
 public:
     future<T> *_future = nullptr;
 
-    async<T> get_return_object() {
+    async<T, Policy> get_return_object() {
         return std::coroutine_handle<async_promise>::from_promise(*this);
     }
+
+    //resolves the future and destroys the frame, returns coroutines to resume
+    static suspend_point<void> finish(async_promise &p, std::coroutine_handle<> me) noexcept {
+        //retrieve future ponter, it can be nullptr for detached coroutine
+        future<T> *f = p._future;
+        tracing::trace(tracing::event::finish, me.address(), f);
+        //set future resolved - this must be done before frame is destroyed
+        //as there can be still connection to the frame before resolution
+        //once the future is resolved, there should be no connection at all.
+        suspend_point<void> sp = f ? f->resolve():suspend_point<void>();
+        //now we can destroy our frame
+        me.destroy();
+        return sp;
+    }
     struct final_awaiter: std::suspend_always {
 
 #ifdef _MSC_VER
@@ -203,6 +220,7 @@ public:
             async_promise &p = me.promise();
             //retrieve future ponter, it can be nullptr for detached coroutine
             future<T> *f = p._future;
+            tracing::trace(tracing::event::finish, me.address(), f);
             ///if future is defined
             if (f) {
                 ///resolve it normally
@@ -215,26 +233,53 @@ public:
 #else
         template<typename Prom>
         std::coroutine_handle<> await_suspend(std::coroutine_handle<Prom> me) noexcept {
-            //retrieve promise object
-            async_promise &p = me.promise();
-            //retrieve future ponter, it can be nullptr for detached coroutine
-            future<T> *f = p._future;
-            //set future resolved - this must be done before frame is destroyed
-            //as there can be still connection to the frame before resolution
-            //once the future is resolved, there should be no connection at all.
-            suspend_point<void> sp = f ? f->resolve():suspend_point<void>();
-            //now we can destroy our frame
-            me.destroy();
-            //return handle returned by resolve();
-            return sp.pop();
+            suspend_point<void> sp = finish(me.promise(), me);
+            if constexpr(std::is_same_v<Policy, resumption_policy::queued>) {
+                //move all coroutines to the queue
+                sp.clear();
+                return std::noop_coroutine();
+            } else {
+                //return handle returned by resolve();
+                return sp.pop();
+            }
         }
 #endif
     };
 
+    ///final awaiter of posting policy, the coroutine is finished in the executor
+    class post_final_awaiter: public awaiter {
+    public:
+        static constexpr bool await_ready() noexcept {return false;}
+        template<typename Prom>
+        void await_suspend(std::coroutine_handle<Prom> me) noexcept {
+            _promise = &me.promise();
+            _handle = me;
+            set_resume_fn(&perform_finish, this);
+            //the frame can be destroyed by other thread from now
+            Policy::post(this);
+        }
+        static constexpr void await_resume() noexcept {}
+    protected:
+        async_promise *_promise = nullptr;
+        std::coroutine_handle<> _handle;
+
+        static suspend_point<void> perform_finish(awaiter *, void *user_ptr) noexcept {
+            post_final_awaiter *_this = reinterpret_cast<post_final_awaiter *>(user_ptr);
+            //the awaiter is part of the frame, so copy everything before it is destroyed
+            return finish(*_this->_promise, _this->_handle);
+        }
+    };
+
     friend class future<T>;
 
     std::suspend_always initial_suspend() noexcept {return {};}
-    final_awaiter final_suspend() noexcept {return {};}
+    auto final_suspend() noexcept {
+        if constexpr(_details::is_posting_policy<Policy>::value) {
+            return post_final_awaiter();
+        } else {
+            return final_awaiter();
+        }
+    }
 
     template<typename ... Args>
     void resolve(Args && ... args) {
@@ -24,6 +24,25 @@ class awaiter;
  */
 using awaiter_collector = std::atomic<awaiter *>;
 
+#if COCLS_MAX_RESUME_DEPTH > 0
+namespace _details {
+
+    ///State of the resume trampoline of current thread
+    /** @see COCLS_MAX_RESUME_DEPTH */
+    struct resume_trampoline {
+        ///depth of nested resume() with a callback
+        unsigned int depth = 0;
+        ///deferred awaiters (FIFO)
+        awaiter *first = nullptr;
+        awaiter *last = nullptr;
+
+        static thread_local resume_trampoline instance;
+    };
+
+    inline thread_local resume_trampoline resume_trampoline::instance;
+}
+#endif
+
 
 ///Helps to store coroutine handle to be resumed.
 class awaiter {
@@ -54,8 +73,13 @@ public:
      *  @note Function is declared as noexcept. Any callback function must avoid to throw exception
      */
     suspend_point<void> resume() noexcept {
+        tracing::trace(tracing::event::resume, _resume_fn?nullptr:_handle_addr, this);
         if (_resume_fn) {
+#if COCLS_MAX_RESUME_DEPTH > 0
+            return resume_limited();
+#else
             return _resume_fn(this, _handle_addr);
+#endif
         }
         else {
             return std::coroutine_handle<>::from_address(_handle_addr);
@@ -155,6 +179,56 @@ protected:
 
     static suspend_point<void> null_fn(awaiter *, void *) noexcept {return {};}
 
+#if COCLS_MAX_RESUME_DEPTH > 0
+    //calls the callback, or defers it, when the stack is too deep
+    suspend_point<void> resume_limited() noexcept {
+        auto &tr = _details::resume_trampoline::instance;
+        if (tr.depth >= COCLS_MAX_RESUME_DEPTH) {
+            _next = nullptr;
+            if (tr.last) tr.last->_next = this; else tr.first = this;
+            tr.last = this;
+            return {};
+        }
+        ++tr.depth;
+        //the callback can destroy this awaiter, don't touch it after the call
+        suspend_point<void> ret = _resume_fn(this, _handle_addr);
+        if (tr.depth == 1) {
+            //outermost resume, run deferred awaiters. They can defer further awaiters
+            while (tr.first) {
+                awaiter *x = tr.first;
+                tr.first = x->_next;
+                if (!tr.first) tr.last = nullptr;
+                x->_next = nullptr;
+                ret << x->_resume_fn(x, x->_handle_addr);
+            }
+        }
+        --tr.depth;
+        return ret;
+    }
+
+    ///Removes this awaiter from awaiters deferred by current thread
+    /**
+     * @retval true removed, the callback will not be called
+     * @retval false the awaiter was not deferred by current thread
+     */
+    bool cancel_deferred() noexcept {
+        auto &tr = _details::resume_trampoline::instance;
+        awaiter *prev = nullptr;
+        for (awaiter *x = tr.first; x; prev = x, x = x->_next) {
+            if (x == this) {
+                (prev?prev->_next:tr.first) = _next;
+                if (tr.last == this) tr.last = prev;
+                _next = nullptr;
+                return true;
+            }
+        }
+        return false;
+    }
+#else
+    ///Removes this awaiter from awaiters deferred by current thread (nothing is deferred)
+    static constexpr bool cancel_deferred() noexcept {return false;}
+#endif
+
 
 
 };
@@ -178,6 +252,7 @@ public:
     ///co_await related function
     bool await_suspend(std::coroutine_handle<> h) {
         set_handle(h);
+        tracing::trace(tracing::event::suspend, h.address(), &this->_owner);
         return this->_owner.subscribe(this);
     }
     ///suspend coroutine but register function to be resumed instead of coroutine itself
@@ -253,9 +328,13 @@ public:
 };
 
 
+///Awaiter which blocks the current thread
+/**
+ * The waiting thread spins according to the idle_policy before it is parked. The
+ * waking thread calls the kernel only when the waiting thread has been parked
+ */
 class sync_awaiter: public awaiter {
 public:
-    std::atomic<bool> flag = {false};
     sync_awaiter() {
         set_resume_fn(&sync_awaiter::wakeup);
     }
@@ -263,18 +342,45 @@ public:
     sync_awaiter &operator=(const sync_awaiter &) = delete;
 
     void wait_sync() {
-        flag.wait(false);
+        if (spin_until(_policy.load(std::memory_order_relaxed), [&]{
+            return _state.load(std::memory_order_acquire) == signaled;
+        })) return;
+        unsigned int s = waiting;
+        if (_state.compare_exchange_strong(s, parked, std::memory_order_acquire)) {
+            do {
+                _state.wait(parked, std::memory_order_acquire);
+            } while (_state.load(std::memory_order_acquire) == parked);
+        }
     }
 
     void wakeup() {
-        flag.store(true);
-        flag.notify_all();
+        if (_state.exchange(signaled, std::memory_order_release) == parked) {
+            _state.notify_all();
+        }
     }
 
     static suspend_point<void> wakeup(awaiter *me, void *) noexcept {
         static_cast<sync_awaiter *>(me)->wakeup();
         return {};
     }
+
+    ///Set idle policy of all synchronous waits
+    static void set_idle_policy(idle_policy policy) {
+        _policy.store(policy, std::memory_order_relaxed);
+    }
+
+    ///Get idle policy of synchronous waits
+    static idle_policy get_idle_policy() {
+        return _policy.load(std::memory_order_relaxed);
+    }
+
+protected:
+    static constexpr unsigned int waiting = 0;
+    static constexpr unsigned int signaled = 1;
+    static constexpr unsigned int parked = 2;
+
+    std::atomic<unsigned int> _state = {waiting};
+    static inline std::atomic<idle_policy> _policy = {idle_policy{64, 0}};
 };
 
 template<typename T, suspend_point<void> (T::*fn)(awaiter *) noexcept>
@@ -312,7 +418,7 @@ inline void co_awaiter<promise_type>::sync() noexcept  {
     assert(!coro_queue::is_active() && "Blocking wait in a coroutine (use force_sync() to override)");
     sync_awaiter awt;
     if (subscribe(&awt)) {
-        awt.flag.wait(false);
+        awt.wait_sync();
     }
 }
 
@@ -321,7 +427,7 @@ inline void co_awaiter<promise_type>::force_sync() noexcept  {
     if (await_ready()) return ;
     sync_awaiter awt;
     if (subscribe(&awt)) {
-        awt.flag.wait(false);
+        awt.wait_sync();
     }
 }
 
@@ -0,0 +1,387 @@
+/**
+ * @file buffer_pool.h
+ *
+ * Pool of fixed-size data buffers with reference counted slices
+ */
+#pragma once
+#ifndef SRC_cocls_BUFFER_POOL_H_
+#define SRC_cocls_BUFFER_POOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <utility>
+
+namespace cocls {
+
+class buffer_pool;
+class buffer_ref;
+
+namespace _details {
+
+///Shared state of the buffer pool
+/**
+ * The state is shared by the pool and by thread caches, so the cache can
+ * return its buffers even after the pool object has been destroyed
+ */
+class buffer_pool_state {
+public:
+
+    static constexpr std::uint32_t npos = ~std::uint32_t(0);
+    ///value of reference counter of a free buffer held by a thread cache
+    static constexpr std::uint32_t cached_mark = ~std::uint32_t(0);
+    static constexpr std::size_t alignment = 4096;
+
+    buffer_pool_state(std::size_t buffer_size, std::uint32_t count)
+        :_buffer_size(buffer_size)
+        ,_count(count)
+        ,_data(static_cast<char *>(::operator new(buffer_size * count, std::align_val_t(alignment))))
+        ,_slots(new slot[count]) {
+        //build free list
+        for (std::uint32_t i = 0; i < count; i++) {
+            _slots[i]._next.store(i+1 < count?i+1:npos, std::memory_order_relaxed);
+        }
+        _head.store(count?0:npos, std::memory_order_relaxed);
+    }
+
+    ~buffer_pool_state() {
+        ::operator delete(_data, std::align_val_t(alignment));
+    }
+
+    buffer_pool_state(const buffer_pool_state &) = delete;
+    buffer_pool_state &operator=(const buffer_pool_state &) = delete;
+
+    ///pop index from global free list (lock-free)
+    std::uint32_t pop() {
+        std::uint64_t h = _head.load(std::memory_order_acquire);
+        for(;;) {
+            std::uint32_t idx = static_cast<std::uint32_t>(h);
+            if (idx == npos) return npos;
+            std::uint32_t next = _slots[idx]._next.load(std::memory_order_relaxed);
+            //tag in upper half protects against ABA
+            std::uint64_t nh = ((h >> 32) + 1) << 32 | next;
+            if (_head.compare_exchange_weak(h, nh, std::memory_order_acquire, std::memory_order_acquire)) {
+                return idx;
+            }
+        }
+    }
+
+    ///push index to global free list (lock-free)
+    void push(std::uint32_t idx) {
+        std::uint64_t h = _head.load(std::memory_order_relaxed);
+        for(;;) {
+            _slots[idx]._next.store(static_cast<std::uint32_t>(h), std::memory_order_relaxed);
+            std::uint64_t nh = ((h >> 32) + 1) << 32 | idx;
+            if (_head.compare_exchange_weak(h, nh, std::memory_order_release, std::memory_order_relaxed)) {
+                return;
+            }
+        }
+    }
+
+    char *data(std::uint32_t idx) const {return _data + idx * _buffer_size;}
+    std::atomic<std::uint32_t> &refs(std::uint32_t idx) {return _slots[idx]._refs;}
+    std::size_t buffer_size() const {return _buffer_size;}
+    std::uint32_t count() const {return _count;}
+    char *base() const {return _data;}
+
+    std::uint32_t acquire();
+    void release(std::uint32_t idx);
+
+    ///mark buffer as held by a thread cache
+    void mark_cached(std::uint32_t idx) {
+        _cached.fetch_add(1, std::memory_order_relaxed);
+        _slots[idx]._refs.store(cached_mark, std::memory_order_release);
+    }
+
+    ///take buffer held by a thread cache
+    /**
+     * @retval true buffer taken
+     * @retval false buffer has been already taken by other thread (stolen)
+     */
+    bool claim_cached(std::uint32_t idx) {
+        std::uint32_t exp = cached_mark;
+        if (_slots[idx]._refs.compare_exchange_strong(exp, 0, std::memory_order_acquire, std::memory_order_relaxed)) {
+            _cached.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    ///take any buffer held by caches of other threads (slow)
+    std::uint32_t steal() {
+        for (std::uint32_t i = 0; i < _count && _cached.load(std::memory_order_relaxed); i++) {
+            if (claim_cached(i)) return i;
+        }
+        return npos;
+    }
+
+protected:
+    struct slot {
+        std::atomic<std::uint32_t> _refs = 0;
+        std::atomic<std::uint32_t> _next = npos;
+    };
+
+    std::size_t _buffer_size;
+    std::uint32_t _count;
+    char *_data;
+    std::unique_ptr<slot[]> _slots;
+    std::atomic<std::uint64_t> _head;
+    //count of buffers held by thread caches
+    std::atomic<std::uint32_t> _cached = 0;
+};
+
+///Per-thread cache of free buffers
+/**
+ * The cache serves single pool, the last one used by the thread. Switching to
+ * another pool returns cached buffers to the previous pool.
+ *
+ * Cached buffers are marked in the pool. When the global free list is empty,
+ * acquire() steals marked buffers from caches of other threads, so the pool is
+ * not exhausted while there are buffers cached by an other thread. Items of
+ * the cache, which have been stolen, are skipped.
+ */
+class buffer_pool_cache {
+public:
+    static constexpr std::uint32_t size = 16;
+
+    ~buffer_pool_cache() {
+        flush();
+    }
+
+    void flush() {
+        if (_st) {
+            while (_count) {
+                std::uint32_t idx = _items[--_count];
+                if (_st->claim_cached(idx)) _st->push(idx);
+            }
+            _st.reset();
+        }
+    }
+
+    std::shared_ptr<buffer_pool_state> _st;
+    std::uint32_t _items[size];
+    std::uint32_t _count = 0;
+
+    static thread_local buffer_pool_cache instance;
+};
+
+inline thread_local buffer_pool_cache buffer_pool_cache::instance;
+
+inline std::uint32_t buffer_pool_state::acquire() {
+    auto &c = buffer_pool_cache::instance;
+    if (c._st.get() == this) {
+        while (c._count) {
+            std::uint32_t idx = c._items[--c._count];
+            if (claim_cached(idx)) return idx;
+        }
+    }
+    std::uint32_t idx = pop();
+    if (idx == npos) idx = steal();
+    return idx;
+}
+
+inline void buffer_pool_state::release(std::uint32_t idx) {
+    auto &c = buffer_pool_cache::instance;
+    if (c._st.get() == this) {
+        if (c._count == buffer_pool_cache::size) {
+            //keep half of the cache, so next acquire/release doesn't hit the global list
+            while (c._count > buffer_pool_cache::size/2) {
+                std::uint32_t x = c._items[--c._count];
+                if (claim_cached(x)) push(x);
+            }
+        }
+        mark_cached(idx);
+        c._items[c._count++] = idx;
+    } else {
+        push(idx);
+    }
+}
+
+}
+
+///Reference to a buffer from the buffer_pool, or to a slice of the buffer
+/**
+ * The object is reference counted. Copying the object doesn't copy data, it just
+ * increases count of references. When the last reference is destroyed, the buffer
+ * is returned to the pool. Moving the object is cheap and doesn't touch the counter,
+ * so it can be passed through queue<buffer_ref>, publisher<buffer_ref>, or
+ * future<buffer_ref> without copying the data.
+ *
+ * @note all references must be released before the pool is destroyed
+ */
+class buffer_ref {
+public:
+
+    ///construct empty reference
+    buffer_ref() = default;
+
+    buffer_ref(const buffer_ref &other)
+        :_st(other._st),_idx(other._idx),_offset(other._offset),_size(other._size) {
+        if (_st) _st->refs(_idx).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    buffer_ref(buffer_ref &&other) noexcept
+        :_st(std::exchange(other._st, nullptr)),_idx(other._idx),_offset(other._offset),_size(other._size) {}
+
+    buffer_ref &operator=(const buffer_ref &other) {
+        if (this != &other) {
+            buffer_ref tmp(other);
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    buffer_ref &operator=(buffer_ref &&other) noexcept {
+        if (this != &other) {
+            buffer_ref tmp(std::move(other));
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    ~buffer_ref() {
+        if (_st && _st->refs(_idx).fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            _st->release(_idx);
+        }
+    }
+
+    void swap(buffer_ref &other) noexcept {
+        std::swap(_st, other._st);
+        std::swap(_idx, other._idx);
+        std::swap(_offset, other._offset);
+        std::swap(_size, other._size);
+    }
+
+    ///pointer to data
+    char *data() const {return _st->data(_idx) + _offset;}
+    ///size of the slice
+    std::size_t size() const {return _size;}
+    ///returns true, if the slice is empty
+    bool empty() const {return _size == 0;}
+    ///returns true, if the reference is valid
+    explicit operator bool() const {return _st != nullptr;}
+    ///convert to span
+    operator std::span<char>() const {return {data(), _size};}
+    ///convert to span
+    operator std::span<const char>() const {return {data(), _size};}
+
+    ///Create a slice
+    /**
+     * @param offset offset relative to this slice
+     * @param count count of bytes. The value is truncated to the end of this slice
+     * @return new reference to the same buffer
+     */
+    buffer_ref slice(std::size_t offset, std::size_t count = ~std::size_t(0)) const {
+        assert(offset <= _size);
+        buffer_ref r(*this);
+        r._offset += offset;
+        r._size = std::min(count, _size - offset);
+        return r;
+    }
+
+    ///Shrink the slice in place
+    /**
+     * Useful after reading into the buffer, to keep only received data
+     * @param count new size, can't be larger than current size
+     */
+    void shrink(std::size_t count) {
+        assert(count <= _size);
+        _size = count;
+    }
+
+    ///Count of references to the buffer (for diagnostics)
+    std::uint32_t use_count() const {
+        return _st?_st->refs(_idx).load(std::memory_order_relaxed):0;
+    }
+
+    ///Index of the buffer in the pool
+    std::uint32_t index() const {return _idx;}
+
+    ///Returns id of the pool, which the buffer belongs to
+    const void *pool_id() const {return _st;}
+
+protected:
+    buffer_ref(_details::buffer_pool_state *st, std::uint32_t idx)
+        :_st(st),_idx(idx),_size(st->buffer_size()) {
+        _st->refs(idx).store(1, std::memory_order_relaxed);
+    }
+
+    _details::buffer_pool_state *_st = nullptr;
+    std::uint32_t _idx = 0;
+    std::uint32_t _offset = 0;
+    std::size_t _size = 0;
+
+    friend class buffer_pool;
+};
+
+///Pool of fixed-size buffers
+/**
+ * Memory of all buffers is allocated as single block (page aligned), so it can be
+ * registered for zero-copy I/O (see io_ring::register_buffers()). Free buffers are
+ * kept in a lock-free list. Every thread also caches few free buffers of
+ * the last used pool, so acquire and release usually don't touch shared memory.
+ *
+ * @code
+ * buffer_pool pool(4096, 1024);
+ * buffer_ref buf = pool.acquire();
+ * std::size_t sz = co_await ring.read(fd, buf, 0);
+ * buf.shrink(sz);
+ * co_await q.push(std::move(buf));     //no data are copied
+ * @endcode
+ */
+class buffer_pool {
+public:
+
+    ///Construct the pool
+    /**
+     * @param buffer_size size of single buffer
+     * @param count count of buffers
+     */
+    buffer_pool(std::size_t buffer_size, std::uint32_t count)
+        :_st(std::make_shared<_details::buffer_pool_state>(buffer_size, count)) {}
+
+    buffer_pool(const buffer_pool &) = delete;
+    buffer_pool &operator=(const buffer_pool &) = delete;
+
+    ~buffer_pool() {
+        //cache of current thread can be released now
+        auto &c = _details::buffer_pool_cache::instance;
+        if (c._st == _st) c.flush();
+    }
+
+    ///Acquire a buffer
+    /**
+     * @return reference to the buffer. If the pool is exhausted, returns empty reference
+     */
+    buffer_ref acquire() {
+        auto &c = _details::buffer_pool_cache::instance;
+        if (c._st != _st) {
+            //switch thread cache to this pool, buffers are fetched on demand
+            c.flush();
+            c._st = _st;
+        }
+        std::uint32_t idx = _st->acquire();
+        if (idx == _details::buffer_pool_state::npos) return {};
+        return buffer_ref(_st.get(), idx);
+    }
+
+    ///Size of a buffer
+    std::size_t buffer_size() const {return _st->buffer_size();}
+    ///Count of buffers
+    std::uint32_t count() const {return _st->count();}
+    ///Memory of all buffers - for registration
+    std::span<char> memory() const {return {_st->base(), _st->buffer_size() * _st->count()};}
+    ///Id of the pool, compare with buffer_ref::pool_id()
+    const void *id() const {return _st.get();}
+
+protected:
+    std::shared_ptr<_details::buffer_pool_state> _st;
+};
+
+}
+
+#endif /* SRC_cocls_BUFFER_POOL_H_ */
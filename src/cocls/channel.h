@@ -0,0 +1,203 @@
+/**
+ * @file channel.h
+ *
+ * Unbuffered (rendezvous) channel
+ */
+#pragma once
+#ifndef SRC_cocls_CHANNEL_H_
+#define SRC_cocls_CHANNEL_H_
+
+#include "select.h"
+#include "select_state.h"
+
+#include <mutex>
+
+namespace cocls {
+
+///Unbuffered channel
+/**
+ * The channel has no buffer. The sender waits until a receiver takes the value and
+ * the receiver waits until a sender is available (rendezvous). Both operations
+ * can be used in select() through send_case and recv_case, even on both sides
+ * of the channel at once.
+ *
+ * @code
+ * channel<int> ch;
+ *
+ * //producer
+ * co_await ch.send(42);
+ *
+ * //consumer
+ * int v = co_await ch.recv();
+ * @endcode
+ *
+ * @tparam T type of transfered value
+ *
+ * @note channel must not be destroyed while there are waiting senders or receivers
+ */
+template<typename T>
+class channel {
+public:
+
+    ///type of transfered value
+    using value_type = T;
+    ///type of waiter of sender or receiver
+    using waiter = select_waiter<select_value_t<T> >;
+
+    channel() = default;
+    channel(const channel &) = delete;
+    channel &operator=(const channel &) = delete;
+
+    ///Receive a value
+    /**
+     * @return awaiter, co_await returns received value. You can also call wait()
+     */
+    auto recv();
+
+    ///Send a value
+    /**
+     * @param args arguments to construct the value
+     * @return awaiter, co_await finishes when the value is received. You can also call wait()
+     */
+    template<typename ... Args>
+    auto send(Args && ... args);
+
+    ///Arm waiter of a receiver
+    /**
+     * If there is a waiting sender, the receiver takes its value, otherwise it is registered
+     */
+    void arm_recv(waiter &w) {
+        std::unique_lock lk(_mx);
+        if (!match(lk, w, _senders, [&](waiter &s){w._value = std::move(s._value);})) {
+            _receivers.push_back(&w);
+        }
+    }
+
+    ///Arm waiter of a sender
+    /**
+     * If there is a waiting receiver, the sender passes its value to the receiver,
+     * otherwise it is registered
+     */
+    void arm_send(waiter &w) {
+        std::unique_lock lk(_mx);
+        if (!match(lk, w, _receivers, [&](waiter &r){r._value = std::move(w._value);})) {
+            _senders.push_back(&w);
+        }
+    }
+
+    ///Remove waiter of a receiver if it is still registered
+    void disarm_recv(waiter &w) {
+        std::lock_guard _(_mx);
+        _receivers.remove(&w);
+    }
+
+    ///Remove waiter of a sender if it is still registered
+    void disarm_send(waiter &w) {
+        std::lock_guard _(_mx);
+        _senders.remove(&w);
+    }
+
+protected:
+    std::mutex _mx;
+    _details::select_list<waiter> _senders;
+    _details::select_list<waiter> _receivers;
+
+    //pairs the waiter with a waiting counterpart, returns false if there is none
+    template<typename Fn>
+    bool match(std::unique_lock<std::mutex> &lk, waiter &w, _details::select_list<waiter> &other, Fn &&transfer) {
+        using pair_result = _details::select_state::pair_result;
+        for (;;) {
+            //the select can't be paired with itself
+            waiter *r = other.find([&](waiter *x){return x->_state != w._state;});
+            if (!r) return false;
+            switch (_details::select_state::claim_pair(*w._state, w._index, *r->_state, r->_index)) {
+                case pair_result::ok:
+                    other.remove(r);
+                    transfer(*r);
+                    lk.unlock();
+                    r->notify();
+                    w.notify();
+                    return true;
+                case pair_result::remote_lost:
+                    other.remove(r);
+                    break;
+                default:
+                case pair_result::self_lost:
+                    return true;
+            }
+        }
+    }
+};
+
+///Case of select(), which receives a value from the channel
+template<typename T>
+class recv_case {
+public:
+    using value_type = select_value_t<T>;
+
+    explicit recv_case(channel<T> &ch):_ch(ch) {}
+    recv_case(recv_case &&other):_ch(other._ch) {}
+
+    void arm(_details::select_state &st, int idx) {
+        _w.bind(st, idx);
+        _ch.arm_recv(_w);
+    }
+    void disarm() {
+        _ch.disarm_recv(_w);
+    }
+    value_type get_result() {
+        return std::move(*_w._value);
+    }
+
+protected:
+    channel<T> &_ch;
+    typename channel<T>::waiter _w;
+};
+
+///Case of select(), which sends a value to the channel
+/**
+ * When the case is not selected, the value is not sent
+ */
+template<typename T>
+class send_case {
+public:
+    using value_type = std::monostate;
+
+    template<typename ... Args>
+    explicit send_case(channel<T> &ch, Args && ... args):_ch(ch) {
+        _w._value.emplace(std::forward<Args>(args)...);
+    }
+    send_case(send_case &&other):_ch(other._ch) {
+        _w._value = std::move(other._w._value);
+    }
+
+    void arm(_details::select_state &st, int idx) {
+        _w.bind(st, idx);
+        _ch.arm_send(_w);
+    }
+    void disarm() {
+        _ch.disarm_send(_w);
+    }
+    value_type get_result() {
+        return {};
+    }
+
+protected:
+    channel<T> &_ch;
+    typename channel<T>::waiter _w;
+};
+
+template<typename T>
+inline auto channel<T>::recv() {
+    return case_awaiter<recv_case<T> >(recv_case<T>(*this));
+}
+
+template<typename T>
+template<typename ... Args>
+inline auto channel<T>::send(Args && ... args) {
+    return case_awaiter<send_case<T> >(send_case<T>(*this, std::forward<Args>(args)...));
+}
+
+}
+
+#endif /* SRC_cocls_CHANNEL_H_ */
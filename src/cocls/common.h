@@ -5,6 +5,11 @@
 #include <algorithm>
 #include <concepts>
 #include <coroutine>
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
 
 
 #ifdef __CDT_PARSER__
@@ -48,6 +53,20 @@
 #endif
 #endif
 
+///Defines maximum depth of nested resumption of awaiters with a callback
+/**
+ * When an awaiter calls a callback, which resolves other future, its awaiters are
+ * resumed recursively. Long chains of such callbacks can overflow the stack. Once the
+ * depth of nesting reaches this limit, further awaiters are not resumed recursively,
+ * they are deferred and resumed by the outermost resume() after the current callback
+ * returns (trampoline). Value 0 disables the limit.
+ *
+ * This constant can be passed at command line as -DCOCLS_MAX_RESUME_DEPTH=32
+ */
+#ifndef COCLS_MAX_RESUME_DEPTH
+#define COCLS_MAX_RESUME_DEPTH 64
+#endif
+
 ///Coroutine classes use this namespace
 namespace cocls {
 
@@ -58,6 +77,27 @@ namespace cocls {
      */
     using coro_id = const void *;
 
+    ///Size of cache line used to separate data accessed by different threads
+    /**
+     * std::hardware_destructive_interference_size is not used, because its value
+     * can differ between compilation units (compiler flags) and it would change
+     * layout of classes in headers
+     */
+    inline constexpr std::size_t cache_line_size = 64;
+
+    ///Places a contended member variable to its own cache line (opt-in)
+    /**
+     * Atomic variables which are modified by other threads than the data stored
+     * next to them cause false sharing. Padding costs memory, so it is enabled
+     * only when the macro COCLS_PAD_CONTENDED is defined. The macro changes layout
+     * of the classes, so it must be defined for all compilation units of the program
+     */
+    #ifdef COCLS_PAD_CONTENDED
+    #define COCLS_CONTENDED alignas(::cocls::cache_line_size)
+    #else
+    #define COCLS_CONTENDED
+    #endif
+
 
 
     #if defined( __cpp_concepts) and not defined (__CDT_PARSER__)
@@ -77,6 +117,51 @@ namespace cocls {
 
 
     #endif
+
+    ///Defines how a thread waits before it is parked (blocked in the kernel)
+    /**
+     * Waking a parked thread costs tens of microseconds. If the thread is expected
+     * to be woken up soon, it is better to spin a while. The thread first spins
+     * spin_count-times (with a cpu pause instruction), then it yields its time
+     * slice yield_count-times, then it is parked.
+     */
+    struct idle_policy {
+        ///count of busy spins
+        unsigned int spin_count = 256;
+        ///count of yields
+        unsigned int yield_count = 2;
+    };
+
+    ///Hints the CPU, that the thread is in a spin loop
+    inline void cpu_relax() noexcept {
+    #if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        _mm_pause();
+    #elif defined(__i386__) || defined(__x86_64__)
+        __builtin_ia32_pause();
+    #elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__("yield");
+    #endif
+    }
+
+    ///Spin and yield according to the policy until the condition is met
+    /**
+     * @param policy idle policy
+     * @param cond condition
+     * @retval true condition is met
+     * @retval false condition is not met, the thread should be parked
+     */
+    template<typename Cond>
+    bool spin_until(const idle_policy &policy, Cond &&cond) {
+        for (unsigned int i = 0; i < policy.spin_count; ++i) {
+            if (cond()) return true;
+            cpu_relax();
+        }
+        for (unsigned int i = 0; i < policy.yield_count; ++i) {
+            if (cond()) return true;
+            std::this_thread::yield();
+        }
+        return cond();
+    }
 }
 
 
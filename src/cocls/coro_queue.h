@@ -4,7 +4,10 @@
 
 
 #include "common.h"
+#include "instrumentation.h"
+#include "tracing.h"
 
+#include <algorithm>
 #include <cassert>
 #include <deque>
 #include <utility>
@@ -59,12 +62,21 @@ struct coro_queue {
         queue_impl(const coro_queue &) = delete;
         queue_impl&operator=(const coro_queue &) = delete;
         std::deque<std::coroutine_handle<> > _queue;
+        ///functions called once the queue is empty
+        std::vector<std::pair<void (*)(void *), void *> > _flush_hooks;
 
         void flush_queue() noexcept {
-            while (!_queue.empty()) {
-                auto h = std::move(_queue.front());
-                _queue.pop_front();
-                h.resume();
+            for(;;) {
+                while (!_queue.empty()) {
+                    auto h = std::move(_queue.front());
+                    _queue.pop_front();
+                    h.resume();
+                }
+                if (_flush_hooks.empty()) break;
+                //hooks can resume coroutines or register new hooks
+                auto hooks = std::move(_flush_hooks);
+                _flush_hooks.clear();
+                for (const auto &[fn, ctx]: hooks) fn(ctx);
             }
 
         }
@@ -126,12 +138,38 @@ struct coro_queue {
     }
 
 
+    ///Register function, which is called when current queue is flushed
+    /**
+     * The function is called once, after all coroutines ready in this thread
+     * are resumed and suspended again (so the queue is empty). It allows to batch
+     * work requested by multiple coroutines, for example to submit many I/O
+     * requests by single syscall. Registering the same function with the same
+     * context again before the flush has no effect.
+     *
+     * @param fn function to call
+     * @param ctx context passed to the function
+     * @retval true registered
+     * @retval false there is no active queue in current thread, the caller
+     * should perform the action now
+     */
+    static bool on_flush(void (*fn)(void *), void *ctx) {
+        if (!instance) return false;
+        auto &hooks = instance->_flush_hooks;
+        auto item = std::make_pair(fn, ctx);
+        if (std::find(hooks.begin(), hooks.end(), item) == hooks.end()) {
+            hooks.push_back(item);
+        }
+        return true;
+    }
+
     ///resume in queue
     static void resume(std::coroutine_handle<> h) noexcept {
+        tracing::trace(tracing::event::queue, h.address(), instance);
 
         if (instance) {
             assert("Attempt to resume empty handle " && h);
             instance->_queue.push_back(h);
+            instrumentation::record(instrumentation::histogram::coro_queue_depth, instance->_queue.size());
         } else {
             install_queue_and_resume(h);
         }
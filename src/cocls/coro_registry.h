@@ -0,0 +1,296 @@
+/**
+ * @file coro_registry.h
+ *
+ * Optional registry of live coroutines
+ *
+ * The registry is enabled by defining the macro COCLS_CORO_REGISTRY before any
+ * header of the library is included. Every async<> and generator<> coroutine
+ * is then registered for its lifetime, and every co_await inside of such coroutine
+ * records what the coroutine awaits and since when. The registry can be enumerated
+ * to find coroutines, which are suspended for too long (for example awaiting a future,
+ * whose promise has been forgotten). See also scheduler::watchdog()
+ *
+ * When the macro is not defined, the coroutines are not registered and co_await
+ * is not affected at all.
+ */
+#pragma once
+#ifndef SRC_cocls_CORO_REGISTRY_H_
+#define SRC_cocls_CORO_REGISTRY_H_
+
+#include "common.h"
+#include "generics.h"
+#include "resumption_policy.h"
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <mutex>
+#include <typeinfo>
+#include <vector>
+
+namespace cocls {
+
+template<typename T> class future;
+template<typename promise_type> class co_awaiter;
+class mutex;
+class thread_pool;
+
+///Type of registered coroutine
+enum class coro_type {
+    async,
+    generator
+};
+
+///Information about a registered coroutine
+struct coro_info {
+    ///identifier of the coroutine (address of the frame). It is nullptr, if the coroutine was never suspended
+    coro_id id;
+    ///type of the coroutine
+    coro_type type;
+    ///address of awaited object (nullptr if running)
+    const void *awaiting;
+    ///description of awaited object (future, mutex, ...)
+    const char *kind;
+    ///how long the coroutine is suspended (zero if running)
+    std::chrono::steady_clock::duration suspended_for;
+};
+
+///Describes type of awaited object. It can be specialized for user's types
+template<typename T>
+struct awaiting_kind {
+    static const char *name() {return typeid(T).name();}
+};
+
+template<typename T>
+struct awaiting_kind<future<T> > {
+    static const char *name() {return "future";}
+};
+
+template<typename T, typename Policy>
+struct awaiting_kind<async<T, Policy> > {
+    static const char *name() {return "async";}
+};
+
+template<>
+struct awaiting_kind<co_awaiter<mutex> > {
+    static const char *name() {return "mutex";}
+};
+
+template<>
+struct awaiting_kind<thread_pool> {
+    static const char *name() {return "thread_pool";}
+};
+
+namespace _details {
+
+///Node of the registry, it is part of coroutine promise
+class coro_registry_node {
+public:
+
+    explicit coro_registry_node(coro_type type);
+    ~coro_registry_node();
+    coro_registry_node(const coro_registry_node &) = delete;
+    coro_registry_node &operator=(const coro_registry_node &) = delete;
+
+    void suspend(coro_id id, const void *object, const char *kind) {
+        _id.store(id, std::memory_order_relaxed);
+        _object.store(object, std::memory_order_relaxed);
+        _kind.store(kind, std::memory_order_relaxed);
+        _since.store(now(), std::memory_order_release);
+    }
+
+    void resumed() {
+        _since.store(0, std::memory_order_relaxed);
+    }
+
+    coro_info info(std::uint64_t t) const {
+        std::uint64_t since = _since.load(std::memory_order_acquire);
+        if (since) {
+            return {_id.load(std::memory_order_relaxed), _type,
+                    _object.load(std::memory_order_relaxed),
+                    _kind.load(std::memory_order_relaxed),
+                    std::chrono::nanoseconds(t > since?t - since:0)};
+        } else {
+            return {_id.load(std::memory_order_relaxed), _type, nullptr, nullptr, {}};
+        }
+    }
+
+    static std::uint64_t now() {
+        //zero is reserved for running state
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count()) | 1;
+    }
+
+    coro_registry_node *_prev = nullptr;
+    coro_registry_node *_next = nullptr;
+    unsigned int _shard;
+
+protected:
+    coro_type _type;
+    std::atomic<coro_id> _id = nullptr;
+    std::atomic<const void *> _object = nullptr;
+    std::atomic<const char *> _kind = nullptr;
+    std::atomic<std::uint64_t> _since = 0;
+};
+
+///Registry is split to shards to reduce contention of threads creating coroutines
+class coro_registry_shards {
+public:
+    static constexpr unsigned int count = 16;
+
+    struct shard {
+        std::mutex _mx;
+        coro_registry_node *_first = nullptr;
+    };
+
+    static coro_registry_shards &get() {
+        static coro_registry_shards r;
+        return r;
+    }
+
+    unsigned int current_shard() {
+        static thread_local unsigned int idx = _next.fetch_add(1, std::memory_order_relaxed) % count;
+        return idx;
+    }
+
+    void add(coro_registry_node *n) {
+        n->_shard = current_shard();
+        shard &s = _shards[n->_shard];
+        std::lock_guard _(s._mx);
+        n->_next = s._first;
+        if (s._first) s._first->_prev = n;
+        s._first = n;
+    }
+
+    void remove(coro_registry_node *n) {
+        shard &s = _shards[n->_shard];
+        std::lock_guard _(s._mx);
+        if (n->_prev) n->_prev->_next = n->_next; else s._first = n->_next;
+        if (n->_next) n->_next->_prev = n->_prev;
+    }
+
+    template<typename Fn>
+    void for_each(Fn &&fn) {
+        for (shard &s: _shards) {
+            std::lock_guard _(s._mx);
+            for (auto n = s._first; n; n = n->_next) fn(*n);
+        }
+    }
+
+protected:
+    shard _shards[count];
+    std::atomic<unsigned int> _next = 0;
+};
+
+inline coro_registry_node::coro_registry_node(coro_type type):_type(type) {
+    coro_registry_shards::get().add(this);
+}
+
+inline coro_registry_node::~coro_registry_node() {
+    coro_registry_shards::get().remove(this);
+}
+
+///Awaiter, which records suspension to the registry
+template<typename Awt>
+class tracked_awaiter {
+public:
+    template<typename Object>
+    tracked_awaiter(Object &&obj, coro_registry_node &node)
+        :_awt(retrieve_awaiter(std::forward<Object>(obj)))
+        ,_node(node)
+        ,_object(&obj)
+        ,_kind(awaiting_kind<std::decay_t<Object> >::name()) {}
+
+    bool await_ready() {return _awt.await_ready();}
+
+    template<typename P>
+    auto await_suspend(std::coroutine_handle<P> h) {
+        _node.suspend(h.address(), _object, _kind);
+        using R = decltype(_awt.await_suspend(h));
+        if constexpr(std::is_same_v<R, bool>) {
+            bool r = _awt.await_suspend(h);
+            //not suspended, the frame is still ours
+            if (!r) _node.resumed();
+            return r;
+        } else {
+            //coroutine can be already resumed in other thread, don't touch the node
+            return _awt.await_suspend(h);
+        }
+    }
+
+    decltype(auto) await_resume() {
+        _node.resumed();
+        return _awt.await_resume();
+    }
+
+protected:
+    Awt _awt;
+    coro_registry_node &_node;
+    const void *_object;
+    const char *_kind;
+};
+
+}
+
+///Access to the registry of coroutines
+class coro_registry {
+public:
+    ///true, if the registry is enabled
+#ifdef COCLS_CORO_REGISTRY
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+
+    ///Retrieve information about all live coroutines
+    static std::vector<coro_info> snapshot() {
+        std::vector<coro_info> out;
+        if constexpr(enabled) {
+            auto t = _details::coro_registry_node::now();
+            _details::coro_registry_shards::get().for_each([&](const _details::coro_registry_node &n){
+                out.push_back(n.info(t));
+            });
+        }
+        return out;
+    }
+
+    ///Retrieve coroutines, which are suspended longer than the threshold
+    /**
+     * @param threshold threshold
+     * @return list of coroutines
+     */
+    template<typename A, typename B>
+    static std::vector<coro_info> stuck(std::chrono::duration<A,B> threshold) {
+        auto lst = snapshot();
+        std::erase_if(lst, [&](const coro_info &nfo) {
+            return nfo.awaiting == nullptr || nfo.suspended_for < threshold;
+        });
+        return lst;
+    }
+};
+
+///Base of coroutine promises, which registers the coroutine
+/**
+ * When the registry is disabled, the class is empty
+ */
+template<coro_type type>
+class coro_registry_hook {
+#ifdef COCLS_CORO_REGISTRY
+public:
+    coro_registry_hook():_node(type) {}
+
+    template<typename Object>
+    auto await_transform(Object &&obj) {
+        using Awt = decltype(retrieve_awaiter(std::forward<Object>(obj)));
+        return _details::tracked_awaiter<Awt>(std::forward<Object>(obj), _node);
+    }
+
+protected:
+    _details::coro_registry_node _node;
+#endif
+};
+
+}
+
+#endif /* SRC_cocls_CORO_REGISTRY_H_ */
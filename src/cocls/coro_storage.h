@@ -173,7 +173,7 @@ public:
         }
     }
 protected:
-    std::atomic<bool> _busy = {false};
+    COCLS_CONTENDED std::atomic<bool> _busy = {false};
 };
 
 
@@ -0,0 +1,319 @@
+/**
+ * @file deadline_executor.h
+ *
+ * Executor which runs work in order of deadlines (earliest deadline first)
+ */
+#pragma once
+#ifndef SRC_cocls_DEADLINE_EXECUTOR_H_
+#define SRC_cocls_DEADLINE_EXECUTOR_H_
+
+#include "coro_queue.h"
+#include "exceptions.h"
+#include "function.h"
+#include "future.h"
+#include "instrumentation.h"
+#include "tracing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cocls {
+
+///Executor with own threads, which dispatches work in order of deadlines
+/**
+ * Every work (coroutine or function) has a deadline. Workers always take the work
+ * with the earliest deadline. If the deadline of a work already passed when the
+ * work is dispatched, the work is not executed - a coroutine is resumed with
+ * deadline_missed_exception, a function is not called and its future throws the exception.
+ * Every miss is counted and reported through the miss handler.
+ *
+ * Deadlines use the same clock as the scheduler (system_clock), so a deadline
+ * can be shared between timeouts of the scheduler and the executor.
+ *
+ * @code
+ * async<void> handler(deadline_executor &exec, deadline_executor::time_point deadline) {
+ *      co_await exec.before(deadline);
+ *      //running in the executor
+ * }
+ * @endcode
+ */
+class deadline_executor {
+public:
+
+    ///clock of the executor (same as clock of the scheduler)
+    using clock = std::chrono::system_clock;
+    ///deadline
+    using time_point = clock::time_point;
+
+    ///State of the work when it is dispatched
+    enum class outcome {
+        ///work should run
+        run,
+        ///deadline has been missed
+        missed,
+        ///executor has been stopped
+        canceled
+    };
+
+    ///work item, it is always called exactly once
+    using q_item = function<void(outcome)>;
+
+    ///handler of a missed deadline, receives the deadline and the time, how late the dispatch was
+    using miss_handler = function<void(time_point, clock::duration)>;
+
+    ///Start the executor
+    /**
+     * @param threads count of threads. Default value creates same amount as count
+     * of available CPU cores (hardware_concurrency)
+     */
+    explicit deadline_executor(unsigned int threads = 0) {
+        if (!threads) threads = std::thread::hardware_concurrency();
+        for (unsigned int i = 0; i < threads; i++) {
+            _threads.push_back(std::thread([this]{worker();}));
+        }
+    }
+
+    deadline_executor(const deadline_executor &) = delete;
+    deadline_executor &operator=(const deadline_executor &) = delete;
+
+    ///Stops the executor. The work which was not dispatched is canceled
+    ~deadline_executor() {
+        stop();
+    }
+
+    ///Stops all threads
+    /**
+     * Work, which was not dispatched, is canceled. Coroutines are resumed with
+     * await_canceled_exception in the current thread.
+     */
+    void stop() {
+        std::vector<std::thread> tmp;
+        std::vector<item> q;
+        {
+            std::lock_guard _(_mx);
+            _exit = true;
+            _cond.notify_all();
+            std::swap(tmp, _threads);
+            std::swap(q, _queue);
+        }
+        auto me = std::this_thread::get_id();
+        for (std::thread &t: tmp) {
+            if (t.get_id() == me) t.detach(); else t.join();
+        }
+        for (item &it: q) it._fn(outcome::canceled);
+    }
+
+    ///Awaiter, which transfers the coroutine to the executor
+    class co_awaiter {
+    public:
+        co_awaiter(deadline_executor &owner, time_point deadline):_owner(owner),_deadline(deadline) {}
+        co_awaiter(const co_awaiter &) = default;
+        co_awaiter &operator=(const co_awaiter &) = delete;
+
+        static constexpr bool await_ready() {return false;}
+
+        void await_suspend(std::coroutine_handle<> h) {
+            _h = h;
+            _owner.enqueue(_deadline, [this](outcome r) {
+                _result = r;
+                coro_queue::resume(_h);
+            });
+        }
+
+        void await_resume() const {
+            switch (_result) {
+                case outcome::missed: throw deadline_missed_exception();
+                case outcome::canceled: throw await_canceled_exception();
+                default: break;
+            }
+        }
+
+    protected:
+        deadline_executor &_owner;
+        time_point _deadline;
+        std::coroutine_handle<> _h;
+        outcome _result = outcome::run;
+    };
+
+    ///Reschedule current coroutine to the executor with a deadline
+    /**
+     * @param deadline deadline
+     * @return awaiter. The co_await throws deadline_missed_exception if the deadline
+     * passed before the coroutine has been dispatched.
+     */
+    co_awaiter before(time_point deadline) {
+        return co_awaiter(*this, deadline);
+    }
+
+    ///Reschedule current coroutine to the executor with a deadline relative to now
+    template<typename A, typename B>
+    co_awaiter within(std::chrono::duration<A,B> dur) {
+        return before(clock::now() + std::chrono::duration_cast<clock::duration>(dur));
+    }
+
+    ///Run function in the executor
+    /**
+     * @param fn function to run
+     * @param deadline deadline. If the deadline passes before the function is dispatched,
+     * the function is not called and the future throws deadline_missed_exception
+     * @return future with the result of the function
+     */
+    template<typename Fn>
+    auto run(Fn &&fn, time_point deadline) -> future<decltype(std::declval<Fn>()())> {
+        using RetVal = decltype(std::declval<Fn>()());
+        return [&](auto promise) {
+            enqueue(deadline, [fn = std::tuple<Fn>(std::forward<Fn>(fn)), promise = std::move(promise)](outcome r) mutable {
+                try {
+                    switch (r) {
+                        case outcome::missed: throw deadline_missed_exception();
+                        case outcome::canceled: throw await_canceled_exception();
+                        default: break;
+                    }
+                    if constexpr(std::is_void_v<RetVal>) {
+                        std::get<0>(fn)();
+                        promise();
+                    } else {
+                        promise(std::get<0>(fn)());
+                    }
+                } catch(...) {
+                    promise(std::current_exception());
+                }
+            });
+        };
+    }
+
+    ///Resume coroutines of a suspend point in the executor
+    /**
+     * All coroutines are enqueued under single lock with the same deadline. These
+     * coroutines are resumed even if the deadline is missed (the miss is only reported),
+     * because they have no way to receive an exception.
+     *
+     * @param spt suspend point
+     * @param deadline deadline
+     * @return value associated with the suspend point
+     */
+    template<typename T>
+    T resume(suspend_point<T> &spt, time_point deadline) {
+        if (!spt.empty()) {
+            std::lock_guard _(_mx);
+            if (!_exit) {
+                std::size_t cnt = 0;
+                while (!spt.empty()) {
+                    std::coroutine_handle<> h = spt.pop();
+                    push_lk(deadline, [h](outcome){coro_queue::resume(h);});
+                    ++cnt;
+                }
+                if (cnt > 1) _cond.notify_all(); else _cond.notify_one();
+            }
+        }
+        if constexpr(!std::is_void_v<T>) {
+            return spt;
+        }
+    }
+
+    ///Resume coroutines of a suspend point in the executor
+    template<typename T>
+    T resume(suspend_point<T> &&spt, time_point deadline) {
+        return resume(spt, deadline);
+    }
+
+    ///Set handler of missed deadlines
+    /**
+     * @param fn handler. It is called in the worker thread before the work is dispatched
+     * as missed.
+     *
+     * @note set the handler before any work is enqueued
+     */
+    void set_miss_handler(miss_handler &&fn) {
+        std::lock_guard _(_mx);
+        _on_miss = std::move(fn);
+    }
+
+    ///Count of dispatched work (including missed)
+    std::uint64_t get_dispatched() const {return _dispatched.load(std::memory_order_relaxed);}
+
+    ///Count of missed deadlines
+    std::uint64_t get_missed() const {return _missed.load(std::memory_order_relaxed);}
+
+    ///Count of enqueued work
+    std::size_t get_enqueued() const {
+        std::lock_guard _(_mx);
+        return _queue.size();
+    }
+
+protected:
+
+    struct item {
+        time_point _deadline;
+        //order of items with the same deadline
+        std::uint64_t _seq;
+        q_item _fn;
+    };
+
+    //heap comparison - earliest deadline on top
+    static bool compare_item(const item &a, const item &b) {
+        if (a._deadline != b._deadline) return a._deadline > b._deadline;
+        return a._seq > b._seq;
+    }
+
+    void enqueue(time_point deadline, q_item &&fn) {
+        tracing::trace(tracing::event::enqueue, nullptr, this);
+        {
+            std::lock_guard _(_mx);
+            if (!_exit) {
+                push_lk(deadline, std::move(fn));
+                _cond.notify_one();
+                return;
+            }
+        }
+        fn(outcome::canceled);
+    }
+
+    void push_lk(time_point deadline, q_item &&fn) {
+        _queue.push_back({deadline, _seq++, std::move(fn)});
+        std::push_heap(_queue.begin(), _queue.end(), compare_item);
+    }
+
+    void worker() {
+        std::unique_lock lk(_mx);
+        for (;;) {
+            _cond.wait(lk, [&]{return !_queue.empty() || _exit;});
+            if (_exit) break;
+            std::pop_heap(_queue.begin(), _queue.end(), compare_item);
+            item it = std::move(_queue.back());
+            _queue.pop_back();
+            lk.unlock();
+            _dispatched.fetch_add(1, std::memory_order_relaxed);
+            auto now = clock::now();
+            if (it._deadline < now) {
+                _missed.fetch_add(1, std::memory_order_relaxed);
+                instrumentation::add(instrumentation::counter::deadline_missed);
+                if (_on_miss) _on_miss(it._deadline, now - it._deadline);
+                it._fn(outcome::missed);
+            } else {
+                it._fn(outcome::run);
+            }
+            lk.lock();
+        }
+    }
+
+    mutable std::mutex _mx;
+    std::condition_variable _cond;
+    std::vector<item> _queue;
+    std::vector<std::thread> _threads;
+    miss_handler _on_miss;
+    std::uint64_t _seq = 0;
+    std::atomic<std::uint64_t> _dispatched = 0;
+    std::atomic<std::uint64_t> _missed = 0;
+    bool _exit = false;
+};
+
+}
+
+#endif /* SRC_cocls_DEADLINE_EXECUTOR_H_ */
@@ -33,6 +33,30 @@ public:
     }
     
 };
+///Thrown from co_await when the operation was not completed in the specified time
+class await_timeout_exception: public std::exception {
+public:
+    const char *what() const noexcept {
+        return "Operation co_await has timed out";
+    }
+};
+
+///Thrown when a work is dispatched after its deadline
+class deadline_missed_exception: public std::exception {
+public:
+    const char *what() const noexcept {
+        return "Deadline has been missed";
+    }
+};
+
+///Thrown when a message is sent to full mailbox without waiting
+class mailbox_full_exception: public std::exception {
+public:
+    const char *what() const noexcept {
+        return "Mailbox is full";
+    }
+};
+
 ///Requested value is no longer available
 class no_longer_avaible_exception: public std::exception {
 public:
@@ -7,6 +7,7 @@
 
 #include "awaiter.h"
 #include "exceptions.h"
+#include "resumption_policy.h"
 #include "with_allocator.h"
 
 
@@ -106,9 +107,6 @@ class future;
 template<typename T>
 class promise;
 
-template<typename T>
-class async_promise;
-
 
 ///Use value drop to drop promise manually
 enum DropTag {drop};
@@ -178,7 +176,8 @@ public:
 
 
 protected:
-    mutable awaiter_collector _awaiter = nullptr;
+    //awaiting threads subscribe here, while the value is written by the resolving thread
+    COCLS_CONTENDED mutable awaiter_collector _awaiter = nullptr;
     State _state=State::not_value;
 };
 
@@ -527,12 +526,12 @@ protected:
     friend class co_awaiter<future<T> >;
     friend class promise<T>;
 
-    template<typename A>
+    template<typename A, typename P>
     friend class async_promise;
 
 
     union {
-        value_storage _value;
+        COCLS_CONTENDED value_storage _value;
         ptr_storage _ptr_value;
         std::exception_ptr _exception;
 
@@ -923,6 +922,9 @@ using future_with_cb_no_alloc = custom_allocator_base<Storage, future_with_cb<T,
  * @param fn callback function. Once the promise is resolved, the callback function receives
  * whole future<T> object as argument (as reference). It can be used to retrieve the value from it
  *
+ * @param storage storage used to allocate the future. The function without this
+ * argument uses slab_storage, so it doesn't call the global allocator in steady state
+ *
  * @return promise<T> object
  *
  * @note callback is executed only after all instances of the promise are destroyed. This helps
@@ -930,11 +932,11 @@ using future_with_cb_no_alloc = custom_allocator_base<Storage, future_with_cb<T,
  * execution is postponed. However ensure, that when promise is resolved, the promise instance
  * is being destroyed as soon as possible
  *
- * @see future<T>::get()
+ * @see future<T>::get(), slab_storage
  */
 template<typename T, typename Fn>
 promise<T> make_promise(Fn &&fn) {
-    auto f = new future_with_cb<T, Fn>(std::forward<Fn>(fn));
+    auto f = new(slab_storage::instance) future_with_cb_no_alloc<T, slab_storage, Fn>(std::forward<Fn>(fn));
     return f->get_promise();
 }
 
@@ -954,7 +956,8 @@ promise<T> make_promise(Fn &&fn, Storage &storage) {
  * @param fn function which returns a future. Function is called. Return value
  * is discarded, so it no longer need to awaited.
  *
- * @note function allocates memory for result, which is destroyed when future is resolved
+ * @note function allocates memory for result in slab_storage, which is released when
+ * future is resolved
  *
  *
  * @code
@@ -977,6 +980,13 @@ void discard(Fn &&fn) {
             delete _this;
             return {};
         }
+
+        void *operator new(std::size_t sz) {
+            return slab_storage::alloc(sz);
+        }
+        void operator delete(void *ptr, std::size_t sz) {
+            slab_storage::dealloc(ptr, sz);
+        }
     protected:
         fut_type _fut;
     };
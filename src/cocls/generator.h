@@ -2,6 +2,7 @@
 #ifndef SRC_cocls_GENERATOR_H_
 #define SRC_cocls_GENERATOR_H_
 #include "awaiter.h"
+#include "coro_registry.h"
 #include "generics.h"
 #include "future.h"
 #include "iterator.h"
@@ -71,7 +72,7 @@ public:
     using future_t = future<T>;    
 
     ///contains coroutine promise
-    class promise_type {
+    class promise_type: public coro_registry_hook<coro_type::generator> {
 
 
         //contains awaiter of caller - which is resumed on co_yield
@@ -4,6 +4,9 @@
 #include "generator.h"
 #include "queue.h"
 
+#include <algorithm>
+#include <functional>
+
 
 namespace cocls {
 
@@ -71,6 +74,30 @@ struct generator_aggregator_controller {
     GenAggrQueue<T, Arg> &_queue;
 };
 
+//tracks count of generators which are still generating, handles final destruction
+/* Unlike generator_aggregator_controller, it doesn't count generators, which
+ * already finished their step. Destructor waits for pending generators only.
+ * This is blocking operation!
+ */
+template<typename T, typename Arg>
+struct generator_aggregator_pending {
+    generator_aggregator_pending(GenAggrQueue<T, Arg> &queue):_queue(queue) {}
+    generator_aggregator_pending(const generator_aggregator_pending  &) = delete;
+    generator_aggregator_pending &operator=(const generator_aggregator_pending  &) = delete;
+    ~generator_aggregator_pending() {
+        while (_count) {
+            _queue.pop().wait();
+            _count--;
+        }
+    }
+    operator bool() const {return _count>0;}
+    void charged() {_count++;}
+    void fin() {_count--;}
+
+    std::size_t _count = 0;
+    GenAggrQueue<T, Arg> &_queue;
+};
+
 
 }
 ///Aggregator of multiple generators
@@ -135,6 +162,209 @@ generator<T, Arg> generator_aggregator(std::vector<generator<T, Arg> > list__) {
 
 }
 
+///Policy of the generator_aggregator, which decides, which of ready generators is served
+enum class aggregator_policy {
+    ///weighted round robin. Weight is count of items served from a generator in its turn.
+    /** A generator, which is not ready, loses its turn, so the aggregator never waits
+     * while other generators are ready */
+    round_robin,
+    ///priority. The ready generator with highest weight is served first. Generators
+    ///with the same priority are served in round robin order
+    priority
+};
+
+///Aggregator of multiple generators with fairness or priority
+/**
+ * Standard generator_aggregator serves generators in order of completion, so a fast
+ * generator can starve the others. This variant collects all generators which are
+ * ready and picks one of them according to the policy.
+ *
+ * @param list__ list of generators to aggregate
+ * @param policy selected policy
+ * @param weights weights of the generators in order of the list. For round_robin, it is
+ * count of items served in one turn, for priority, it is the priority (higher is served first).
+ * Missing weights are set to 1. Zero is also treated as 1
+ * @return generator
+ *
+ * @code
+ * //take two items from the primary source per one item of the secondary source
+ * auto gen = generator_aggregator(std::move(sources), aggregator_policy::round_robin, {2,1});
+ * @endcode
+ *
+ * @note for generator with an argument, the aggregator works same way as the standard
+ * generator_aggregator.
+ */
+template<typename T, typename Arg>
+generator<T, Arg> generator_aggregator(std::vector<generator<T, Arg> > list__, aggregator_policy policy, std::vector<unsigned int> weights = {}) {
+
+    std::exception_ptr exp;
+
+    using Queue = _details::GenAggrQueue<T, Arg>;
+    using GenCallback = _details::GenCallback<T, Arg>;
+    using pending = _details::generator_aggregator_pending<T, Arg>;
+
+    const std::size_t count = list__.size();
+    if (!count) co_return;
+    weights.resize(count, 1);
+    for (auto &w: weights) w = std::max(w, 1U);
+
+    std::vector<GenCallback> cbs;
+    cbs.reserve(count);
+    //generators which finished their step, indexed same as cbs
+    std::vector<GenCallback *> ready(count, nullptr);
+    std::size_t ready_count = 0;
+    Queue queue;
+    pending pnd(queue);
+
+    auto mark_ready = [&](GenCallback *gcb) {
+        pnd.fin();
+        if (!gcb->get_generator().done()) {
+            ready[gcb - cbs.data()] = gcb;
+            ++ready_count;
+        }
+    };
+
+    if constexpr(std::is_void_v<Arg>) {
+        for (auto &x: list__) {
+            cbs.emplace_back(queue, std::move(x));
+            pnd.charged();
+            cbs.back().charge();
+        }
+    } else {
+        auto arg = co_yield nullptr;
+        for (auto &x: list__) {
+            cbs.emplace_back(queue, std::move(x));
+            pnd.charged();
+            cbs.back().charge(arg);
+        }
+    }
+
+    std::size_t cursor = 0;
+    unsigned int credit = weights[0];
+
+    while (pnd || ready_count) {
+        if (!ready_count) {
+            GenCallback *gcb = co_await queue.pop();
+            mark_ready(gcb);
+        }
+        //collect other ready generators, so the policy can choose
+        for (;;) {
+            auto gcb = queue.try_pop();
+            if (!gcb) break;
+            mark_ready(*gcb);
+        }
+        if (!ready_count) continue;
+
+        std::size_t idx;
+        if (policy == aggregator_policy::priority) {
+            idx = count;
+            for (std::size_t i = 1; i <= count; i++) {
+                std::size_t j = (cursor + i) % count;
+                if (ready[j] && (idx == count || weights[j] > weights[idx])) idx = j;
+            }
+            cursor = idx;
+        } else {
+            while (!ready[cursor] || !credit) {
+                cursor = (cursor + 1) % count;
+                credit = weights[cursor];
+            }
+            --credit;
+            idx = cursor;
+        }
+
+        GenCallback *gcb = std::exchange(ready[idx], nullptr);
+        --ready_count;
+        auto &g = gcb->get_generator();
+        try {
+            if constexpr(std::is_void_v<Arg>) {
+                co_yield g.value();
+                pnd.charged();
+                gcb->charge();
+            } else {
+                auto arg = co_yield g.value();
+                pnd.charged();
+                gcb->charge(arg);
+            }
+        } catch (...) {
+            exp = std::current_exception();
+        }
+    }
+    if (exp) std::rethrow_exception(exp);
+}
+
+///Merges sorted generators into one sorted generator (k-way merge)
+/**
+ * Each generator must generate items sorted by the comparator. The result is sorted
+ * by the same comparator. Only one item per generator is held in memory. Items with
+ * equivalent keys are generated in order of generators in the list.
+ *
+ * All generators run concurrently while the first items are being collected. Then
+ * only the generator whose item has been generated is asked for the next item.
+ *
+ * @param list__ list of sorted generators
+ * @param comp comparator (default std::less)
+ * @return generator which generates merged items
+ *
+ * @code
+ * std::vector<generator<record> > shards = ...;
+ * for (auto &r: merge_sorted(std::move(shards), [](const record &a, const record &b){return a.key < b.key;})) {
+ *      ...
+ * }
+ * @endcode
+ */
+template<typename T, typename Compare = std::less<> >
+generator<T> merge_sorted(std::vector<generator<T> > list__, Compare comp = {}) {
+
+    using Queue = _details::GenAggrQueue<T, void>;
+    using GenCallback = _details::GenCallback<T, void>;
+    using pending = _details::generator_aggregator_pending<T, void>;
+
+    std::vector<GenCallback> cbs;
+    cbs.reserve(list__.size());
+    Queue queue;
+    pending pnd(queue);
+
+    for (auto &x: list__) {
+        cbs.emplace_back(queue, std::move(x));
+        pnd.charged();
+        cbs.back().charge();
+    }
+
+    //collect first items of all generators
+    std::vector<std::size_t> heap;
+    heap.reserve(cbs.size());
+    while (pnd) {
+        GenCallback *gcb = co_await queue.pop();
+        pnd.fin();
+        if (!gcb->get_generator().done()) heap.push_back(gcb - cbs.data());
+    }
+
+    //ordering of the heap - returns true, if a is served after b
+    auto after = [&](std::size_t a, std::size_t b) {
+        auto &va = cbs[a].get_generator().value();
+        auto &vb = cbs[b].get_generator().value();
+        if (comp(vb, va)) return true;
+        if (comp(va, vb)) return false;
+        return a > b;
+    };
+
+    std::make_heap(heap.begin(), heap.end(), after);
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), after);
+        std::size_t idx = heap.back();
+        heap.pop_back();
+        co_yield cbs[idx].get_generator().value();
+        pnd.charged();
+        cbs[idx].charge();
+        GenCallback *gcb = co_await queue.pop();
+        pnd.fin();
+        if (!gcb->get_generator().done()) {
+            heap.push_back(idx);
+            std::push_heap(heap.begin(), heap.end(), after);
+        }
+    }
+}
+
 
 }
 #endif /* SRC_cocls_GENERATOR_AGGREGATOR_H_ */
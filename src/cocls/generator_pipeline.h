@@ -0,0 +1,328 @@
+/** @file generator_pipeline.h */
+#pragma once
+#ifndef SRC_cocls_GENERATOR_PIPELINE_H_
+#define SRC_cocls_GENERATOR_PIPELINE_H_
+#include "generator.h"
+#include "thread_pool.h"
+
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace cocls {
+
+/*
+ * Note: coroutines in this file don't use co_await in the condition of a loop (as while (co_await ...)),
+ * because some compilers (GCC 12) miscompile such loops. The result is stored to a local variable
+ * instead
+ */
+
+namespace _details {
+
+//bounded ring of items passed from a producer to a consumer
+/*
+ * Items are stored in preallocated std::optional slots, so passing an item through
+ * the ring doesn't allocate. The producer parks on reserve() when the ring is full,
+ * the consumer parks on available() when the ring is empty. Functions which release
+ * the other side return suspend_point, so the caller decides, where the other side
+ * is resumed
+ */
+template<typename T>
+class generator_ring {
+public:
+    generator_ring(std::size_t size):_slots(std::max<std::size_t>(size, 1)) {}
+    generator_ring(const generator_ring &) = delete;
+    generator_ring &operator=(const generator_ring &) = delete;
+
+    //producer - waits for a free slot
+    /* @retval true slot is available
+     * @retval false consumer has gone, producer should exit
+     */
+    future<bool> reserve() {
+        return [&](auto promise) {
+            std::lock_guard _(_mx);
+            if (_stop) promise(false);
+            else if (_count < _slots.size()) promise(true);
+            else _producer = std::move(promise);
+        };
+    }
+
+    //producer - stores item to the reserved slot, releases the consumer
+    template<typename ... Args>
+    suspend_point<void> put(Args && ... args) {
+        std::unique_lock lk(_mx);
+        if (_stop) return {};
+        _slots[_wr].emplace(std::forward<Args>(args)...);
+        _wr = advance(_wr);
+        ++_count;
+        promise<bool> c = std::move(_consumer);
+        lk.unlock();
+        return c(true);
+    }
+
+    //producer - no more items, optionally with an exception
+    suspend_point<void> close(std::exception_ptr e = nullptr) {
+        std::unique_lock lk(_mx);
+        _closed = true;
+        _exp = std::move(e);
+        promise<bool> c = std::move(_consumer);
+        lk.unlock();
+        return c(false);
+    }
+
+    //consumer - waits for an item
+    /* @retval true item is available, use front()
+     * @retval false no more items
+     */
+    future<bool> available() {
+        return [&](auto promise) {
+            std::lock_guard _(_mx);
+            if (_count) promise(true);
+            else if (_closed) promise(false);
+            else _consumer = std::move(promise);
+        };
+    }
+
+    //consumer - access item, available() must return true
+    T &front() {
+        return *_slots[_rd];
+    }
+
+    //consumer - releases current item, releases the producer
+    suspend_point<void> release() {
+        _slots[_rd].reset();
+        std::unique_lock lk(_mx);
+        _rd = advance(_rd);
+        --_count;
+        promise<bool> p = std::move(_producer);
+        lk.unlock();
+        return p(true);
+    }
+
+    //consumer - no more items are requested, releases the producer
+    suspend_point<void> stop() {
+        std::unique_lock lk(_mx);
+        _stop = true;
+        promise<bool> p = std::move(_producer);
+        lk.unlock();
+        return p(false);
+    }
+
+    //consumer - rethrows exception reported by the producer
+    void rethrow() {
+        std::lock_guard _(_mx);
+        if (_exp) std::rethrow_exception(_exp);
+    }
+
+protected:
+    std::mutex _mx;
+    std::vector<std::optional<T> > _slots;
+    std::size_t _rd = 0;
+    std::size_t _wr = 0;
+    std::size_t _count = 0;
+    bool _closed = false;
+    bool _stop = false;
+    std::exception_ptr _exp;
+    promise<bool> _consumer;
+    promise<bool> _producer;
+
+    std::size_t advance(std::size_t pos) const {
+        ++pos;
+        return pos == _slots.size()?0:pos;
+    }
+};
+
+//runs generator and stores generated items to the ring
+template<typename T>
+async<void> generator_ring_producer(generator<T> gen, generator_ring<typename generator<T>::Ret> &ring) {
+    try {
+        for (;;) {
+            bool ok = co_await ring.reserve();
+            if (!ok) break;
+            ok = co_await gen.next();
+            if (!ok) break;
+            ring.put(std::move(gen.value()));
+        }
+        ring.close();
+    } catch (...) {
+        ring.close(std::current_exception());
+    }
+}
+
+//stops the producer when consumer is destroyed
+/* Because producer can be pending, we need to wait until it exits, before the ring
+ * can be destroyed. This is blocking operation!
+ */
+template<typename T>
+struct generator_ring_guard {
+    generator_ring_guard(generator_ring<T> &ring, future<void> &producer):_ring(ring),_producer(producer) {}
+    generator_ring_guard(const generator_ring_guard &) = delete;
+    generator_ring_guard &operator=(const generator_ring_guard &) = delete;
+    ~generator_ring_guard() {
+        //parked producer is resumed in nested queue, so it can exit before we block
+        coro_queue::install_queue_and_call([&]{_ring.stop();});
+        _producer.force_sync();
+    }
+
+    generator_ring<T> &_ring;
+    future<void> &_producer;
+};
+
+//consumer of the ring, starts the producer and forwards items
+/*
+ * @param resume function which receives suspend_point<void> with the producer, when it
+ * needs to be resumed
+ */
+template<typename T, typename Resume>
+generator<T> generator_ring_consumer(generator<T> gen, std::size_t count, Resume resume) {
+    using Ret = typename generator<T>::Ret;
+    generator_ring<Ret> ring(count);
+    future<void> producer;
+    resume(generator_ring_producer<T>(std::move(gen), ring).start(producer.get_promise()));
+    generator_ring_guard<Ret> guard(ring, producer);
+    for (;;) {
+        bool ok = co_await ring.available();
+        if (!ok) break;
+        co_yield ring.front();
+        resume(ring.release());
+    }
+    ring.rethrow();
+}
+
+}
+
+///Transforms items of the generator
+/**
+ * @param gen source generator
+ * @param fn function which receives reference to the generated item and returns
+ * transformed value
+ * @return generator which generates transformed values
+ *
+ * @code
+ * auto records = map(read_lines(file), parse_record);
+ * @endcode
+ */
+template<typename T, typename Fn>
+auto map(generator<T> gen, Fn fn) -> generator<std::decay_t<std::invoke_result_t<Fn &, typename generator<T>::Ret &> > > {
+    for (;;) {
+        bool ok = co_await gen.next();
+        if (!ok) break;
+        auto v = fn(gen.value());
+        co_yield v;
+    }
+}
+
+///Passes only items which satisfy the predicate
+/**
+ * @param gen source generator
+ * @param pred predicate, receives reference to the generated item, returns true to
+ * pass the item, or false to skip it
+ * @return generator
+ */
+template<typename T, typename Fn>
+generator<T> filter(generator<T> gen, Fn pred) {
+    for (;;) {
+        bool ok = co_await gen.next();
+        if (!ok) break;
+        auto &v = gen.value();
+        if (pred(v)) co_yield v;
+    }
+}
+
+///Limits count of items
+/**
+ * @param gen source generator
+ * @param count maximum count of items
+ * @return generator which finishes after count of items or when source generator is finished
+ */
+template<typename T>
+generator<T> take(generator<T> gen, std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) {
+        bool ok = co_await gen.next();
+        if (!ok) break;
+        co_yield gen.value();
+    }
+}
+
+///Groups items into batches
+/**
+ * @param gen source generator
+ * @param count count of items in the batch. The last batch can be shorter
+ * @return generator which generates std::vector of items. The consumer can move
+ * the vector out.
+ */
+template<typename T>
+generator<std::vector<typename generator<T>::Ret> > batch(generator<T> gen, std::size_t count) {
+    std::vector<typename generator<T>::Ret> b;
+    b.reserve(count);
+    for (;;) {
+        bool ok = co_await gen.next();
+        if (!ok) break;
+        b.push_back(std::move(gen.value()));
+        if (b.size() >= count) {
+            co_yield b;
+            b.clear();
+            b.reserve(count);
+        }
+    }
+    if (!b.empty()) co_yield b;
+}
+
+///Runs the generator ahead in a thread pool
+/**
+ * The source generator is iterated in the thread pool and generated items are stored
+ * in a bounded ring. The consumer picks items from the ring, so the producer and the
+ * consumer overlap. When the ring is full, the producer waits for a free slot.
+ *
+ * @param gen source generator
+ * @param count count of slots in the ring. Passing the item through the ring
+ * doesn't allocate
+ * @param pool thread pool, where the source generator runs
+ * @return generator
+ *
+ * @code
+ * auto out = map(buffer(map(read_lines(file), parse), 64, pool), serialize);
+ * @endcode
+ *
+ * @note if the returned generator is destroyed before the source generator is finished,
+ * the destructor blocks until the pending source generator returns from the current step
+ */
+template<typename T>
+generator<T> buffer(generator<T> gen, std::size_t count, thread_pool &pool) {
+    return _details::generator_ring_consumer(std::move(gen), count, [&pool](suspend_point<void> &&sp){
+        pool.resume(std::move(sp));
+    });
+}
+
+///Prefetches items of the generator
+/**
+ * Keeps up to count items generated in advance. The source generator is resumed
+ * as soon as a slot in the ring is released, so the latency of an asynchronous
+ * generator (reading from disk, fetching pages from a backend) is hidden
+ * while the consumer processes already generated items. Unlike buffer(), the source
+ * generator runs in the context, which released the slot (no thread is allocated)
+ *
+ * @param gen source generator
+ * @param count count of items generated in advance. Items are stored in preallocated
+ * slots, there is no allocation per item
+ * @return generator, which can be accessed through next(), iterator or operator() as
+ * the source generator
+ *
+ * @code
+ * for (auto &row: read_ahead(scan_pages(query), 4)) {
+ *      process(row);
+ * }
+ * @endcode
+ *
+ * @note if the returned generator is destroyed before the source generator is finished,
+ * the destructor blocks until the pending source generator returns from the current step
+ */
+template<typename T>
+generator<T> read_ahead(generator<T> gen, std::size_t count) {
+    return _details::generator_ring_consumer(std::move(gen), count, [](suspend_point<void> &&){
+        //discarded suspend point resumes the source generator in current context
+    });
+}
+
+}
+#endif /* SRC_cocls_GENERATOR_PIPELINE_H_ */
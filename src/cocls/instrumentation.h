@@ -0,0 +1,323 @@
+/**
+ * @file instrumentation.h
+ *
+ * Opt-in counters and latency histograms of the library primitives
+ *
+ * Instrumentation is enabled by defining the macro COCLS_INSTRUMENTATION before
+ * any header of the library is included (or by the compiler's command line). When
+ * the macro is not defined, all functions are empty and the compiler removes them.
+ */
+#pragma once
+#ifndef SRC_cocls_INSTRUMENTATION_H_
+#define SRC_cocls_INSTRUMENTATION_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace cocls {
+
+namespace instrumentation {
+
+#ifdef COCLS_INSTRUMENTATION
+///true if the instrumentation is enabled
+constexpr bool enabled = true;
+#else
+///true if the instrumentation is enabled
+constexpr bool enabled = false;
+#endif
+
+///Counters
+enum class counter {
+    ///mutex acquired without waiting
+    mutex_lock,
+    ///mutex was already locked, the caller had to wait
+    mutex_contended,
+    ///ownership of mutex has been passed to a waiting coroutine
+    mutex_handoff,
+    ///deadline_executor dispatched a work after its deadline
+    deadline_missed,
+
+    _count
+};
+
+///Histograms
+enum class histogram {
+    ///length of the thread_pool's queue after a task has been enqueued
+    thread_pool_queue_depth,
+    ///time in nanoseconds, which task spent in thread_pool's queue
+    thread_pool_dispatch_latency,
+    ///length of the coro_queue after a coroutine has been enqueued
+    coro_queue_depth,
+    ///time in nanoseconds, which consumer spent waiting on queue::pop()
+    queue_wait_time,
+    ///time in nanoseconds between deadline and actual expiration of scheduled task
+    scheduler_lateness,
+    ///count of tasks held by the scheduler when a new task is scheduled
+    scheduler_timers,
+    ///count of items, which the subscriber is behind the publisher
+    publisher_lag,
+    ///count of threads of an elastic thread_pool, recorded when a thread is started or retired
+    thread_pool_size,
+
+    _count
+};
+
+///Returns name of the counter
+inline const char *name(counter c) {
+    static const char *names[] = {
+        "mutex_lock", "mutex_contended", "mutex_handoff", "deadline_missed"
+    };
+    return names[static_cast<int>(c)];
+}
+
+///Returns name of the histogram
+inline const char *name(histogram h) {
+    static const char *names[] = {
+        "thread_pool_queue_depth", "thread_pool_dispatch_latency", "coro_queue_depth",
+        "queue_wait_time", "scheduler_lateness", "scheduler_timers", "publisher_lag",
+        "thread_pool_size"
+    };
+    return names[static_cast<int>(h)];
+}
+
+constexpr std::size_t counter_count = static_cast<std::size_t>(counter::_count);
+constexpr std::size_t histogram_count = static_cast<std::size_t>(histogram::_count);
+
+///Log-linear buckets (4 sub-buckets per power of two, relative error 25%)
+/**
+ * Values 0-3 have own bucket, other values are stored to bucket according to the
+ * highest bit and two following bits.
+ */
+constexpr unsigned int bucket_count = 252;
+
+///Calculate bucket for a value
+constexpr unsigned int bucket_index(std::uint64_t v) {
+    if (v < 4) return static_cast<unsigned int>(v);
+    unsigned int e = static_cast<unsigned int>(std::bit_width(v)) - 1;
+    unsigned int sub = static_cast<unsigned int>(v >> (e - 2)) & 3;
+    return (e - 1) * 4 + sub;
+}
+
+///Calculate lowest value stored in the bucket
+constexpr std::uint64_t bucket_lower_bound(unsigned int b) {
+    if (b < 4) return b;
+    unsigned int e = b / 4 + 1;
+    return static_cast<std::uint64_t>(4 + b % 4) << (e - 2);
+}
+
+///Snapshot of a histogram
+struct histogram_snapshot {
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t max = 0;
+    std::array<std::uint64_t, bucket_count> buckets = {};
+
+    ///Mean value
+    double mean() const {
+        return count?static_cast<double>(sum)/static_cast<double>(count):0.0;
+    }
+
+    ///Retrieve approximate value at given percentile
+    /**
+     * @param p percentile 0-100
+     * @return lower bound of the bucket, which contains the value
+     */
+    std::uint64_t percentile(double p) const {
+        if (!count) return 0;
+        std::uint64_t limit = static_cast<std::uint64_t>(static_cast<double>(count) * p / 100.0);
+        std::uint64_t acc = 0;
+        for (unsigned int i = 0; i < bucket_count; i++) {
+            acc += buckets[i];
+            if (acc > limit) return std::min(bucket_lower_bound(i), max);
+        }
+        return max;
+    }
+};
+
+///Snapshot of all metrics
+struct snapshot {
+    std::array<std::int64_t, counter_count> counters = {};
+    std::array<histogram_snapshot, histogram_count> histograms = {};
+
+    std::int64_t operator[](counter c) const {return counters[static_cast<std::size_t>(c)];}
+    const histogram_snapshot &operator[](histogram h) const {return histograms[static_cast<std::size_t>(h)];}
+
+    ///Export snapshot as text, one metric per line
+    friend std::ostream &operator<<(std::ostream &out, const snapshot &s) {
+        for (std::size_t i = 0; i < counter_count; i++) {
+            out << name(static_cast<counter>(i)) << " " << s.counters[i] << "\n";
+        }
+        for (std::size_t i = 0; i < histogram_count; i++) {
+            const histogram_snapshot &h = s.histograms[i];
+            out << name(static_cast<histogram>(i))
+                << " count=" << h.count
+                << " mean=" << h.mean()
+                << " p50=" << h.percentile(50)
+                << " p99=" << h.percentile(99)
+                << " max=" << h.max << "\n";
+        }
+        return out;
+    }
+};
+
+namespace _details {
+
+///Metrics of single thread
+/**
+ * Only the owning thread writes to the block, so updates are plain load and store
+ * without locked instructions. Atomics allow to read the block from other thread
+ */
+struct thread_block {
+    struct hist {
+        std::atomic<std::uint64_t> _count = 0;
+        std::atomic<std::uint64_t> _sum = 0;
+        std::atomic<std::uint64_t> _max = 0;
+        std::atomic<std::uint64_t> _buckets[bucket_count] = {};
+    };
+    std::atomic<std::int64_t> _counters[counter_count] = {};
+    hist _hist[histogram_count];
+
+    template<typename X, typename Y>
+    static void inc(std::atomic<X> &a, Y v) {
+        a.store(a.load(std::memory_order_relaxed) + static_cast<X>(v), std::memory_order_relaxed);
+    }
+
+    void add(counter c, std::int64_t v) {
+        inc(_counters[static_cast<std::size_t>(c)], v);
+    }
+
+    void record(histogram h, std::uint64_t v) {
+        hist &x = _hist[static_cast<std::size_t>(h)];
+        inc(x._count, 1);
+        inc(x._sum, v);
+        if (x._max.load(std::memory_order_relaxed) < v) x._max.store(v, std::memory_order_relaxed);
+        inc(x._buckets[bucket_index(v)], 1);
+    }
+
+    void collect(snapshot &s) const {
+        for (std::size_t i = 0; i < counter_count; i++) {
+            s.counters[i] += _counters[i].load(std::memory_order_relaxed);
+        }
+        for (std::size_t i = 0; i < histogram_count; i++) {
+            const hist &x = _hist[i];
+            histogram_snapshot &h = s.histograms[i];
+            h.count += x._count.load(std::memory_order_relaxed);
+            h.sum += x._sum.load(std::memory_order_relaxed);
+            h.max = std::max(h.max, x._max.load(std::memory_order_relaxed));
+            for (unsigned int b = 0; b < bucket_count; b++) {
+                h.buckets[b] += x._buckets[b].load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+///Registry of blocks of all threads
+class registry {
+public:
+    static registry &get() {
+        static registry r;
+        return r;
+    }
+
+    void add(thread_block *b) {
+        std::lock_guard _(_mx);
+        _blocks.push_back(b);
+    }
+
+    void remove(thread_block *b) {
+        std::lock_guard _(_mx);
+        //keep values of finished thread
+        b->collect(_retired);
+        std::erase(_blocks, b);
+    }
+
+    snapshot collect() {
+        std::lock_guard _(_mx);
+        snapshot s = _retired;
+        for (const thread_block *b: _blocks) b->collect(s);
+        return s;
+    }
+
+protected:
+    std::mutex _mx;
+    std::vector<thread_block *> _blocks;
+    snapshot _retired;
+};
+
+struct thread_block_holder {
+    thread_block _block;
+    thread_block_holder() {registry::get().add(&_block);}
+    ~thread_block_holder() {registry::get().remove(&_block);}
+};
+
+inline thread_block &current_block() {
+    static thread_local thread_block_holder holder;
+    return holder._block;
+}
+
+}
+
+///Returns current time in nanoseconds (steady clock)
+inline std::uint64_t now() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+///Increment the counter
+inline void add([[maybe_unused]] counter c, [[maybe_unused]] std::int64_t v = 1) {
+    if constexpr(enabled) _details::current_block().add(c, v);
+}
+
+///Record value to the histogram
+inline void record([[maybe_unused]] histogram h, [[maybe_unused]] std::uint64_t v) {
+    if constexpr(enabled) _details::current_block().record(h, v);
+}
+
+///Collect metrics of all threads
+/**
+ * The snapshot includes threads, which already finished. When the instrumentation
+ * is disabled, returns empty snapshot
+ */
+inline snapshot take_snapshot() {
+    if constexpr(enabled) return _details::registry::get().collect();
+    else return {};
+}
+
+///Queue of time stamps, which follows a queue of waiting items
+/**
+ * Owner pushes time stamp when item is enqueued and pops it when the item is dequeued,
+ * elapsed time is recorded to the histogram. When the instrumentation is disabled, the
+ * object is empty and does nothing. Access must be protected by the owner's lock.
+ */
+class stamp_queue {
+public:
+#ifdef COCLS_INSTRUMENTATION
+    void push() {_q.push_back(now());}
+    void pop(histogram h) {
+        if (_q.empty()) return;
+        record(h, now() - _q.front());
+        _q.pop_front();
+    }
+    void clear() {_q.clear();}
+protected:
+    std::deque<std::uint64_t> _q;
+#else
+    void push() {}
+    void pop(histogram) {}
+    void clear() {}
+#endif
+};
+
+}
+
+}
+
+#endif /* SRC_cocls_INSTRUMENTATION_H_ */
@@ -0,0 +1,461 @@
+/**
+ * @file io_ring.h
+ *
+ * Asynchronous file and socket I/O based on io_uring (Linux only)
+ */
+#pragma once
+#ifndef SRC_cocls_IO_RING_H_
+#define SRC_cocls_IO_RING_H_
+
+#ifdef __linux__
+
+#include "buffer_pool.h"
+#include "coro_queue.h"
+#include "future.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace cocls {
+
+///I/O service based on io_uring
+/**
+ * Every operation prepares a submission entry and returns a future. The entries
+ * are not submitted immediately. If the operation is requested from a coroutine,
+ * the submission is postponed until the coroutine queue of current thread is flushed,
+ * so all coroutines which became ready in the same cycle are submitted by
+ * single syscall. Outside of coroutine, the entry is submitted immediately.
+ *
+ * Completions are processed by a loop, which occupies one worker of the thread
+ * pool. The completion resolves the promise directly (the user data of the entry
+ * is the awaiting future), resumed coroutines are transferred to other workers.
+ *
+ * @code
+ * thread_pool pool(4);
+ * io_ring ring(pool);
+ *
+ * async<void> copy(io_ring &ring, int src, int dst) {
+ *      char buff[4096];
+ *      std::uint64_t off = 0;
+ *      for(;;) {
+ *          std::size_t sz = co_await ring.read(src, buff, off);
+ *          if (sz == 0) break;
+ *          co_await ring.write(dst, std::span<const char>(buff, sz), off);
+ *          off += sz;
+ *      }
+ * }
+ * @endcode
+ *
+ * When io_uring is not available (old kernel, forbidden by seccomp), the object
+ * falls back to blocking syscalls executed in the thread pool. The interface
+ * is the same, so the code stays portable and testable on any Linux.
+ *
+ * @note all operations must be finished before the object is destroyed
+ */
+class io_ring {
+public:
+
+    ///Selects implementation
+    enum class backend {
+        ///use io_uring if available, otherwise blocking
+        automatic,
+        ///use io_uring, throw exception if not available
+        uring,
+        ///use blocking syscalls in the thread pool
+        blocking
+    };
+
+    ///Construct the I/O service
+    /**
+     * @param pool thread pool. The completion loop occupies one worker. In blocking mode,
+     * the operations are executed by the workers
+     * @param entries size of submission queue
+     * @param b requested backend
+     */
+    io_ring(thread_pool &pool, unsigned int entries = 256, backend b = backend::automatic)
+        :_pool(pool) {
+        if (b != backend::blocking) {
+            int err = init(entries);
+            if (err == 0) {
+                pool.run_detached([g = run_guard(this)]{g.get()->completion_loop();});
+            } else if (b == backend::uring) {
+                throw std::system_error(err, std::generic_category(), "io_uring_setup");
+            }
+        }
+    }
+
+    io_ring(const io_ring &) = delete;
+    io_ring &operator=(const io_ring &) = delete;
+
+    ///Destroy the service
+    ~io_ring() {
+        if (_fd < 0) return;
+        //NOP entry stops the completion loop. When the queue is full, retry until
+        //the entry is prepared and submitted
+        bool nop = false;
+        while (_running.load(std::memory_order_acquire)) {
+            {
+                std::lock_guard _(_mx);
+                if (!nop) {
+                    io_uring_sqe *sqe = get_sqe();
+                    if (sqe) {
+                        sqe->opcode = IORING_OP_NOP;
+                        sqe->user_data = 0;
+                        commit_sqe();
+                        nop = true;
+                    }
+                }
+                submit_pending();
+            }
+            std::this_thread::yield();
+        }
+        unmap();
+        ::close(_fd);
+    }
+
+    ///Returns active backend (uring or blocking)
+    backend get_backend() const {
+        return _fd < 0?backend::blocking:backend::uring;
+    }
+
+    ///Returns count of submit syscalls
+    /**
+     * Useful to measure effectivity of batching
+     */
+    std::size_t get_submit_count() const {
+        return _submits.load(std::memory_order_relaxed);
+    }
+
+    ///Read from the file at given offset
+    /**
+     * @param fd file descriptor
+     * @param buffer buffer, must stay valid until the operation completes
+     * @param offset position in the file
+     * @return future with count of bytes read, zero at the end of file. Error is reported
+     * as std::system_error
+     */
+    future<std::size_t> read(int fd, std::span<char> buffer, std::uint64_t offset) {
+        return io_op(IORING_OP_READ, fd, buffer.data(), buffer.size(), offset);
+    }
+
+    ///Read from the stream (socket, pipe) or at the current position of the file
+    /**
+     * @param fd file descriptor
+     * @param buffer buffer, must stay valid until the operation completes
+     * @return future with count of bytes read, zero at the end of stream
+     */
+    future<std::size_t> read(int fd, std::span<char> buffer) {
+        return io_op(IORING_OP_READ, fd, buffer.data(), buffer.size(), current_position);
+    }
+
+    ///Write to the file at given offset
+    /**
+     * @param fd file descriptor
+     * @param buffer data to write, must stay valid until the operation completes
+     * @param offset position in the file
+     * @return future with count of bytes written
+     */
+    future<std::size_t> write(int fd, std::span<const char> buffer, std::uint64_t offset) {
+        return io_op(IORING_OP_WRITE, fd, const_cast<char *>(buffer.data()), buffer.size(), offset);
+    }
+
+    ///Write to the stream (socket, pipe) or at the current position of the file
+    /**
+     * @param fd file descriptor
+     * @param buffer data to write, must stay valid until the operation completes
+     * @return future with count of bytes written
+     */
+    future<std::size_t> write(int fd, std::span<const char> buffer) {
+        return io_op(IORING_OP_WRITE, fd, const_cast<char *>(buffer.data()), buffer.size(), current_position);
+    }
+
+    ///Register memory of the buffer pool as fixed buffer
+    /**
+     * Registered memory is pinned by the kernel, so operations with buffer_ref
+     * don't need to map pages for every request. Register the pool before any
+     * operation is started. Only one pool can be registered. In blocking mode
+     * the function does nothing.
+     *
+     * @param pool buffer pool. It must stay valid while it is registered
+     */
+    void register_buffers(const buffer_pool &pool) {
+        if (_fd < 0) return;
+        auto mem = pool.memory();
+        iovec iov{mem.data(), mem.size()};
+        std::lock_guard _(_mx);
+        if (_fixed) {
+            syscall(__NR_io_uring_register, _fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+            _fixed = nullptr;
+        }
+        if (syscall(__NR_io_uring_register, _fd, IORING_REGISTER_BUFFERS, &iov, 1) < 0) {
+            throw std::system_error(errno, std::generic_category(), "io_uring_register");
+        }
+        _fixed = pool.id();
+    }
+
+    ///Read from the file into the buffer from the buffer pool
+    /**
+     * If the pool is registered, the operation uses fixed buffer
+     *
+     * @param fd file descriptor
+     * @param buffer buffer, must stay valid until the operation completes
+     * @param offset position in the file
+     * @return future with count of bytes read
+     */
+    future<std::size_t> read(int fd, const buffer_ref &buffer, std::uint64_t offset) {
+        bool fixed = is_fixed(buffer);
+        return io_op(fixed?IORING_OP_READ_FIXED:IORING_OP_READ, fd, buffer.data(), buffer.size(), offset);
+    }
+
+    ///Write to the file from the buffer from the buffer pool
+    /**
+     * If the pool is registered, the operation uses fixed buffer
+     *
+     * @param fd file descriptor
+     * @param buffer buffer, must stay valid until the operation completes
+     * @param offset position in the file
+     * @return future with count of bytes written
+     */
+    future<std::size_t> write(int fd, const buffer_ref &buffer, std::uint64_t offset) {
+        bool fixed = is_fixed(buffer);
+        return io_op(fixed?IORING_OP_WRITE_FIXED:IORING_OP_WRITE, fd, buffer.data(), buffer.size(), offset);
+    }
+
+protected:
+
+    static constexpr std::uint64_t current_position = ~std::uint64_t(0);
+
+    thread_pool &_pool;
+    int _fd = -1;
+    std::mutex _mx;
+    //count of prepared entries, which were not submitted yet
+    unsigned int _pending = 0;
+    std::atomic<std::size_t> _submits = 0;
+    //count of scheduled or running completion loops
+    std::atomic<int> _running = 0;
+    //id of registered buffer pool
+    const void *_fixed = nullptr;
+
+    io_uring_params _params = {};
+    void *_sq_ptr = MAP_FAILED;
+    void *_cq_ptr = MAP_FAILED;
+    io_uring_sqe *_sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+    std::size_t _sq_size = 0;
+    std::size_t _cq_size = 0;
+    unsigned *_sq_head = nullptr;
+    unsigned *_sq_tail = nullptr;
+    unsigned *_sq_mask = nullptr;
+    unsigned *_cq_head = nullptr;
+    unsigned *_cq_tail = nullptr;
+    unsigned *_cq_mask = nullptr;
+    io_uring_cqe *_cqes = nullptr;
+    //local copy of the tail, published by commit_sqe()
+    unsigned _tail = 0;
+
+    //counts the completion loop in _running until it is finished or dropped by stopped pool
+    class run_guard {
+    public:
+        run_guard(io_ring *owner):_owner(owner) {
+            _owner->_running.fetch_add(1, std::memory_order_relaxed);
+        }
+        run_guard(run_guard &&other):_owner(std::exchange(other._owner, nullptr)) {}
+        run_guard &operator=(const run_guard &) = delete;
+        ~run_guard() {
+            //the object can be destroyed from now
+            if (_owner) _owner->_running.fetch_sub(1, std::memory_order_release);
+        }
+        io_ring *get() const {return _owner;}
+    protected:
+        io_ring *_owner;
+    };
+
+    template<typename X>
+    static X *at(void *base, unsigned offset) {
+        return reinterpret_cast<X *>(static_cast<char *>(base) + offset);
+    }
+
+    int init(unsigned int entries) {
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &_params));
+        if (fd < 0) return errno;
+        _fd = fd;
+        _sq_size = _params.sq_off.array + _params.sq_entries * sizeof(unsigned);
+        _cq_size = _params.cq_off.cqes + _params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (_params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) _sq_size = _cq_size = std::max(_sq_size, _cq_size);
+        _sq_ptr = mmap(nullptr, _sq_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (_sq_ptr != MAP_FAILED) {
+            _cq_ptr = single?_sq_ptr:mmap(nullptr, _cq_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        }
+        if (_cq_ptr != MAP_FAILED) {
+            _sqes = static_cast<io_uring_sqe *>(mmap(nullptr, _params.sq_entries * sizeof(io_uring_sqe),
+                    PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES));
+        }
+        if (_sqes == MAP_FAILED) {
+            int e = errno;
+            unmap();
+            ::close(fd);
+            _fd = -1;
+            return e;
+        }
+        _sq_head = at<unsigned>(_sq_ptr, _params.sq_off.head);
+        _sq_tail = at<unsigned>(_sq_ptr, _params.sq_off.tail);
+        _sq_mask = at<unsigned>(_sq_ptr, _params.sq_off.ring_mask);
+        _cq_head = at<unsigned>(_cq_ptr, _params.cq_off.head);
+        _cq_tail = at<unsigned>(_cq_ptr, _params.cq_off.tail);
+        _cq_mask = at<unsigned>(_cq_ptr, _params.cq_off.ring_mask);
+        _cqes = at<io_uring_cqe>(_cq_ptr, _params.cq_off.cqes);
+        //identity mapping between the ring and the array of entries
+        unsigned *array = at<unsigned>(_sq_ptr, _params.sq_off.array);
+        for (unsigned i = 0; i < _params.sq_entries; i++) array[i] = i;
+        _tail = *_sq_tail;
+        return 0;
+    }
+
+    void unmap() {
+        if (_sqes != MAP_FAILED) munmap(_sqes, _params.sq_entries * sizeof(io_uring_sqe));
+        if (_cq_ptr != MAP_FAILED && _cq_ptr != _sq_ptr) munmap(_cq_ptr, _cq_size);
+        if (_sq_ptr != MAP_FAILED) munmap(_sq_ptr, _sq_size);
+        _sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+        _sq_ptr = _cq_ptr = MAP_FAILED;
+    }
+
+    bool is_fixed(const buffer_ref &buffer) const {
+        return _fixed && buffer.pool_id() == _fixed;
+    }
+
+    int enter(unsigned int to_submit, unsigned int min_complete, unsigned int flags) {
+        int r = static_cast<int>(syscall(__NR_io_uring_enter, _fd, to_submit, min_complete, flags, nullptr, 0));
+        return r < 0?-errno:r;
+    }
+
+    //returns free entry, submits pending entries when the ring is full, must be called under lock
+    io_uring_sqe *get_sqe() {
+        unsigned head = std::atomic_ref<unsigned>(*_sq_head).load(std::memory_order_acquire);
+        if (_tail - head >= _params.sq_entries) {
+            submit_pending();
+            head = std::atomic_ref<unsigned>(*_sq_head).load(std::memory_order_acquire);
+            if (_tail - head >= _params.sq_entries) return nullptr;
+        }
+        io_uring_sqe *sqe = _sqes + (_tail & *_sq_mask);
+        std::memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    //publish prepared entry to the kernel, must be called under lock
+    void commit_sqe() {
+        ++_tail;
+        ++_pending;
+        std::atomic_ref<unsigned>(*_sq_tail).store(_tail, std::memory_order_release);
+    }
+
+    //submit all pending entries, must be called under lock
+    void submit_pending() {
+        while (_pending) {
+            int r = enter(_pending, 0, 0);
+            if (r < 0) {
+                if (r == -EINTR) continue;
+                //entries stay in the ring, they are submitted by next call
+                break;
+            }
+            _submits.fetch_add(1, std::memory_order_relaxed);
+            _pending -= std::min<unsigned>(_pending, static_cast<unsigned>(r));
+            if (r == 0) break;
+        }
+    }
+
+    static void flush_hook(void *ctx) {
+        io_ring *me = static_cast<io_ring *>(ctx);
+        std::lock_guard _(me->_mx);
+        me->submit_pending();
+    }
+
+    future<std::size_t> io_op(std::uint8_t opcode, int fd, char *buffer, std::size_t size, std::uint64_t offset) {
+        return [&](auto promise) {
+            if (_fd < 0) {
+                blocking_op(opcode, fd, buffer, size, offset, std::move(promise));
+                return;
+            }
+            std::lock_guard _(_mx);
+            io_uring_sqe *sqe = get_sqe();
+            if (!sqe) {
+                promise.set_exception(std::make_exception_ptr(std::system_error(EBUSY, std::generic_category(), "io_uring")));
+                return;
+            }
+            sqe->opcode = opcode;
+            sqe->fd = fd;
+            sqe->addr = reinterpret_cast<std::uintptr_t>(buffer);
+            sqe->len = static_cast<unsigned int>(std::min<std::size_t>(size, 0x7FFFF000));
+            sqe->off = offset;
+            //the awaiting future is the user data, completion doesn't need any lookup
+            //whole pool is registered as buffer 0
+            sqe->buf_index = 0;
+            sqe->user_data = reinterpret_cast<std::uintptr_t>(promise.claim());
+            commit_sqe();
+            //submit once the coroutines of this thread are suspended
+            if (!coro_queue::on_flush(&flush_hook, this)) submit_pending();
+        };
+    }
+
+    void blocking_op(std::uint8_t opcode, int fd, char *buffer, std::size_t size, std::uint64_t offset, promise<std::size_t> &&p) {
+        _pool.run_detached([=, p = std::move(p)]() mutable {
+            ssize_t r;
+            if (opcode == IORING_OP_READ || opcode == IORING_OP_READ_FIXED) {
+                r = offset == current_position ? ::read(fd, buffer, size) : ::pread(fd, buffer, size, static_cast<off_t>(offset));
+            } else {
+                r = offset == current_position ? ::write(fd, buffer, size) : ::pwrite(fd, buffer, size, static_cast<off_t>(offset));
+            }
+            if (r < 0) p.set_exception(std::make_exception_ptr(std::system_error(errno, std::generic_category(), "io_ring")));
+            else p(static_cast<std::size_t>(r));
+        });
+    }
+
+    void completion_loop() {
+        bool exit = false;
+        while (!exit) {
+            suspend_point<void> sp;
+            unsigned head = std::atomic_ref<unsigned>(*_cq_head).load(std::memory_order_relaxed);
+            unsigned tail = std::atomic_ref<unsigned>(*_cq_tail).load(std::memory_order_acquire);
+            if (head == tail) {
+                enter(0, 1, IORING_ENTER_GETEVENTS);
+                continue;
+            }
+            while (head != tail) {
+                const io_uring_cqe &cqe = _cqes[head & *_cq_mask];
+                if (cqe.user_data == 0) {
+                    exit = true;
+                } else {
+                    promise<std::size_t> p(*reinterpret_cast<future<std::size_t> *>(static_cast<std::uintptr_t>(cqe.user_data)));
+                    if (cqe.res < 0) {
+                        sp << p.set_exception(std::make_exception_ptr(std::system_error(-cqe.res, std::generic_category(), "io_ring")));
+                    } else {
+                        sp << p(static_cast<std::size_t>(cqe.res));
+                    }
+                }
+                ++head;
+            }
+            std::atomic_ref<unsigned>(*_cq_head).store(head, std::memory_order_release);
+            _pool.resume(sp);
+        }
+    }
+
+};
+
+}
+
+#endif
+
+#endif /* SRC_cocls_IO_RING_H_ */
@@ -7,6 +7,7 @@
 #define SRC_cocls_MUTEX_H_
 
 #include "awaiter.h"
+#include "instrumentation.h"
 
 
 namespace cocls {
@@ -131,13 +132,13 @@ protected:
 
     //requests to lock
     /*this is linked list in stack order LIFO, with atomic append feature */
-    awaiter_collector _requests = nullptr;
+    COCLS_CONTENDED awaiter_collector _requests = nullptr;
     //queue of requests, contains awaiters ordered in order of incoming
     /*this is also LIFO, but reversed - because reading LIFO to LIFO results FIFO
      * The queue is accessed under lock. It is build by unlocking thread
      * if the queue is empty by reversing _request. This is handled atomically
      */
-    awaiter *_queue = nullptr;
+    COCLS_CONTENDED awaiter *_queue = nullptr;
 
     //when queue is build, we need object, which acts as doorman
     /*presence of doorman marks object locked. By removing doorman, object becomes unlocked */
@@ -171,6 +172,7 @@ protected:
         _queue = _queue->_next;
         //clear _next ptr to avoid leaking invalid pointer to next code
         first->_next = nullptr;
+        instrumentation::add(instrumentation::counter::mutex_handoff);
         //resume awaiter - it has ownership now
         fn(first);
         //now the _queue is also handled by the new owners
@@ -182,6 +184,7 @@ protected:
         awaiter *n = nullptr;
         bool ok = _requests.compare_exchange_strong(n, doorman());
         //if ok = true, object is guarder by doorman
+        instrumentation::add(ok?instrumentation::counter::mutex_lock:instrumentation::counter::mutex_contended);
         return ok;
     }
 
@@ -0,0 +1,304 @@
+/**
+ * @file parallel_algorithms.h
+ *
+ * Data parallel algorithms running in a thread pool
+ *
+ * The algorithms split the range to chunks of the grain size. The work is split
+ * recursively, every task enqueues the upper half of its chunks and continues with
+ * the lower half, so idle workers pick large pieces of the work first. Result
+ * is returned as single future, which can be co_awaited without blocking the
+ * worker, or waited synchronously.
+ *
+ * @note the range and the functions must stay valid until the future is resolved
+ */
+#pragma once
+#ifndef SRC_cocls_PARALLEL_ALGORITHMS_H_
+#define SRC_cocls_PARALLEL_ALGORITHMS_H_
+
+#include "future.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <exception>
+#include <iterator>
+#include <ranges>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cocls {
+
+namespace _details {
+
+///chooses grain which creates few chunks per thread
+inline std::size_t parallel_grain(std::size_t count, std::size_t grain) {
+    if (grain) return grain;
+    std::size_t parts = std::max<std::size_t>(std::thread::hardware_concurrency(), 1) * 8;
+    return std::max<std::size_t>(count / parts, 1);
+}
+
+///Shared state of a parallel job
+/**
+ * @tparam Body object which implements leaf(first, last, chunk) and finish(exception)
+ */
+template<typename Body>
+class parallel_job {
+public:
+
+    parallel_job(thread_pool &pool, std::size_t count, std::size_t grain, Body &&body)
+        :_pool(pool)
+        ,_count(count)
+        ,_grain(grain)
+        ,_chunks((count + grain - 1) / grain)
+        ,_pending(_chunks)
+        ,_body(std::move(body)) {}
+
+    ///start the job in the pool. The job deletes itself when finished
+    static void start(thread_pool &pool, std::size_t count, std::size_t grain, Body &&body) {
+        if (count == 0) {
+            body.finish(nullptr);
+            return;
+        }
+        auto job = new parallel_job(pool, count, parallel_grain(count, grain), std::move(body));
+        pool.run_detached(task(job, 0, job->_chunks));
+    }
+
+    void run(std::size_t first_chunk, std::size_t last_chunk) {
+        //split recursively, upper half goes to the pool
+        while (last_chunk - first_chunk > 1) {
+            std::size_t mid = first_chunk + (last_chunk - first_chunk) / 2;
+            _pool.run_detached(task(this, mid, last_chunk));
+            last_chunk = mid;
+        }
+        //when failed, remaining chunks are skipped
+        if (!_failed.load(std::memory_order_relaxed)) {
+            try {
+                std::size_t first = first_chunk * _grain;
+                _body.leaf(first, std::min(first + _grain, _count), first_chunk);
+            } catch (...) {
+                if (!_failed.exchange(true, std::memory_order_relaxed)) {
+                    _exception = std::current_exception();
+                }
+            }
+        }
+        done(1);
+    }
+
+    ///cancel chunks of a task, which will not run
+    void cancel(std::size_t first_chunk, std::size_t last_chunk) {
+        if (!_failed.exchange(true, std::memory_order_relaxed)) {
+            _exception = std::make_exception_ptr(await_canceled_exception());
+        }
+        done(last_chunk - first_chunk);
+    }
+
+protected:
+
+    ///Task processing a range of chunks
+    /**
+     * When the task is dropped without running (the pool has been stopped), its
+     * chunks are canceled, so the job is finished anyway
+     */
+    class task {
+    public:
+        task(parallel_job *job, std::size_t first, std::size_t last)
+            :_job(job),_first(first),_last(last) {}
+        task(task &&other)
+            :_job(std::exchange(other._job, nullptr)),_first(other._first),_last(other._last) {}
+        task &operator=(const task &) = delete;
+        ~task() {
+            if (_job) _job->cancel(_first, _last);
+        }
+        void operator()() {
+            std::exchange(_job, nullptr)->run(_first, _last);
+        }
+    protected:
+        parallel_job *_job;
+        std::size_t _first;
+        std::size_t _last;
+    };
+
+    void done(std::size_t chunks) {
+        if (_pending.fetch_sub(chunks, std::memory_order_acq_rel) == chunks) {
+            _body.finish(_exception);
+            delete this;
+        }
+    }
+
+    thread_pool &_pool;
+    std::size_t _count;
+    std::size_t _grain;
+    std::size_t _chunks;
+    std::atomic<std::size_t> _pending;
+    std::atomic<bool> _failed = false;
+    std::exception_ptr _exception;
+    Body _body;
+};
+
+template<typename Fn>
+class parallel_for_body {
+public:
+    parallel_for_body(Fn &&fn, promise<void> &&p):_fn(std::move(fn)),_promise(std::move(p)) {}
+
+    void leaf(std::size_t first, std::size_t last, std::size_t) {
+        for (std::size_t i = first; i < last; ++i) _fn(i);
+    }
+    void finish(std::exception_ptr e) {
+        if (e) _promise(std::move(e)); else _promise();
+    }
+
+protected:
+    Fn _fn;
+    promise<void> _promise;
+};
+
+template<typename R, typename Fold, typename Combine>
+class parallel_reduce_body {
+public:
+    template<typename C>
+    parallel_reduce_body(std::size_t count, std::size_t grain, R identity, Fold &&fold, C &&combine, promise<R> &&p)
+        :_identity(std::move(identity))
+        ,_partials((count + grain - 1) / grain, _identity)
+        ,_fold(std::move(fold))
+        ,_combine(std::forward<C>(combine))
+        ,_promise(std::move(p)) {}
+
+    void leaf(std::size_t first, std::size_t last, std::size_t chunk) {
+        R acc = _identity;
+        for (std::size_t i = first; i < last; ++i) acc = _fold(std::move(acc), i);
+        _partials[chunk] = std::move(acc);
+    }
+    void finish(std::exception_ptr e) {
+        if (e) {
+            _promise(std::move(e));
+            return;
+        }
+        //partials are combined in order of chunks, so the result is deterministic
+        try {
+            R acc = std::move(_identity);
+            for (R &x: _partials) acc = _combine(std::move(acc), std::move(x));
+            _promise(std::move(acc));
+        } catch (...) {
+            _promise(std::current_exception());
+        }
+    }
+
+protected:
+    R _identity;
+    std::vector<R> _partials;
+    Fold _fold;
+    Combine _combine;
+    promise<R> _promise;
+};
+
+}
+
+///Call a function for every index of the range in the thread pool
+/**
+ * @param pool thread pool
+ * @param first first index
+ * @param last index after last
+ * @param grain count of indexes processed by single task. Zero chooses the grain automatically
+ * @param fn function called with the index
+ * @return future which is resolved when all indexes are processed. If the function throws
+ * an exception, the future is resolved with the first exception and remaining chunks are skipped
+ */
+template<std::integral Index, typename Fn>
+future<void> parallel_for(thread_pool &pool, Index first, Index last, std::size_t grain, Fn &&fn) {
+    return [&](auto promise) {
+        auto wrap = [first, fn = std::forward<Fn>(fn)](std::size_t i) mutable {
+            fn(static_cast<Index>(first + static_cast<Index>(i)));
+        };
+        using Body = _details::parallel_for_body<decltype(wrap)>;
+        std::size_t count = last > first?static_cast<std::size_t>(last - first):0;
+        _details::parallel_job<Body>::start(pool, count, grain, Body(std::move(wrap), std::move(promise)));
+    };
+}
+
+///Call a function for every element of the range in the thread pool
+/**
+ * @param pool thread pool
+ * @param range random access range. It must stay valid until the future is resolved
+ * @param grain count of elements processed by single task. Zero chooses the grain automatically
+ * @param fn function called with reference to the element
+ * @return future which is resolved when all elements are processed
+ */
+template<std::ranges::random_access_range Range, typename Fn>
+future<void> parallel_for(thread_pool &pool, Range &range, std::size_t grain, Fn &&fn) {
+    return [&](auto promise) {
+        auto wrap = [b = std::ranges::begin(range), fn = std::forward<Fn>(fn)](std::size_t i) mutable {
+            fn(b[i]);
+        };
+        using Body = _details::parallel_for_body<decltype(wrap)>;
+        std::size_t count = static_cast<std::size_t>(std::ranges::distance(range));
+        _details::parallel_job<Body>::start(pool, count, grain, Body(std::move(wrap), std::move(promise)));
+    };
+}
+
+///Reduce the range in the thread pool
+/**
+ * Every chunk is folded separately starting by the identity, then partial results
+ * are combined in order of chunks.
+ *
+ * @param pool thread pool
+ * @param range random access range. It must stay valid until the future is resolved
+ * @param grain count of elements processed by single task. Zero chooses the grain automatically
+ * @param identity initial value of every chunk, and the result for empty range
+ * @param fold function R(R acc, element) which accumulates an element
+ * @param combine function R(R a, R b) which combines two partial results
+ * @return future with the result
+ */
+template<std::ranges::random_access_range Range, typename R, typename Fold, typename Combine>
+future<R> parallel_reduce(thread_pool &pool, Range &range, std::size_t grain, R identity, Fold &&fold, Combine &&combine) {
+    return [&](auto promise) {
+        auto wrap = [b = std::ranges::begin(range), fold = std::forward<Fold>(fold)](R acc, std::size_t i) mutable {
+            return static_cast<R>(fold(std::move(acc), b[i]));
+        };
+        using Body = _details::parallel_reduce_body<R, decltype(wrap), std::decay_t<Combine> >;
+        std::size_t count = static_cast<std::size_t>(std::ranges::distance(range));
+        std::size_t g = _details::parallel_grain(count, grain);
+        _details::parallel_job<Body>::start(pool, count, g,
+                Body(count, g, std::move(identity), std::move(wrap), std::forward<Combine>(combine), std::move(promise)));
+    };
+}
+
+///Reduce the range in the thread pool, when the same operation folds and combines
+/**
+ * @param pool thread pool
+ * @param range random access range. It must stay valid until the future is resolved
+ * @param grain count of elements processed by single task. Zero chooses the grain automatically
+ * @param identity initial value
+ * @param op associative operation R(R, R), for example std::plus<>
+ * @return future with the result
+ */
+template<std::ranges::random_access_range Range, typename R, typename Op>
+future<R> parallel_reduce(thread_pool &pool, Range &range, std::size_t grain, R identity, Op op) {
+    return parallel_reduce(pool, range, grain, std::move(identity), op, op);
+}
+
+///Transform the range in the thread pool
+/**
+ * @param pool thread pool
+ * @param range random access range. It must stay valid until the future is resolved
+ * @param out random access iterator to the output. There must be space for all results
+ * @param grain count of elements processed by single task. Zero chooses the grain automatically
+ * @param fn function which transforms an element
+ * @return future which is resolved when all elements are transformed
+ */
+template<std::ranges::random_access_range Range, std::random_access_iterator Out, typename Fn>
+future<void> parallel_transform(thread_pool &pool, Range &range, Out out, std::size_t grain, Fn &&fn) {
+    return [&](auto promise) {
+        auto wrap = [b = std::ranges::begin(range), out, fn = std::forward<Fn>(fn)](std::size_t i) mutable {
+            out[i] = fn(b[i]);
+        };
+        using Body = _details::parallel_for_body<decltype(wrap)>;
+        std::size_t count = static_cast<std::size_t>(std::ranges::distance(range));
+        _details::parallel_job<Body>::start(pool, count, grain, Body(std::move(wrap), std::move(promise)));
+    };
+}
+
+}
+
+#endif /* SRC_cocls_PARALLEL_ALGORITHMS_H_ */
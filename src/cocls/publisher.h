@@ -6,6 +6,7 @@
 #ifndef SRC_COCLASSES_PUBLISHER_H_
 #define SRC_COCLASSES_PUBLISHER_H_
 #include "future.h"
+#include "instrumentation.h"
 
 #include "iterator.h"
 #include <deque>
@@ -232,6 +233,7 @@ public:
         std::optional<T> get_value_lk(Handle h, subscribtion_type type) {
             subreg_t &l = _regs[h];
             if (l._kicked || l._pos == _pos) return {};
+            instrumentation::record(instrumentation::histogram::publisher_lag, _pos - l._pos - 1);
             switch (type) {
                 default:
                 case subscribtion_type::all_values: {
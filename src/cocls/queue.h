@@ -8,6 +8,8 @@
 #include "common.h"
 #include "exceptions.h"
 #include "future.h"
+#include "instrumentation.h"
+#include "select_state.h"
 
 #include <coroutine>
 
@@ -129,6 +131,11 @@ template<typename T,
          typename Lock = std::mutex >
 class queue {
 public:
+    ///type of item
+    using value_type = T;
+    ///type of waiter used by select()
+    using pop_waiter = select_waiter<select_value_t<T> >;
+
     ///construct empty queue
     queue() = default;
 
@@ -150,13 +157,20 @@ public:
         if (!_awaiters.empty()) {
             promise<T> p = std::move(_awaiters.front());
             _awaiters.pop();
+            _wait_stamps.pop(instrumentation::histogram::queue_wait_time);
             lk.unlock();
             return p(std::forward<Args>(args)...);
-        } else {
-            _queue.emplace(std::forward<Args>(args)...);
-            return false;
         }
-
+        //waiters of select() which already completed elsewhere are dropped
+        while (pop_waiter *w = _select_waiters.pop_front()) {
+            if (w->claim()) {
+                w->_value.emplace(std::forward<Args>(args)...);
+                lk.unlock();
+                return {w->notify(), true};
+            }
+        }
+        _queue.emplace(std::forward<Args>(args)...);
+        return false;
     }
 
     ///Determines, whether queue is empty
@@ -199,6 +213,7 @@ public:
             std::unique_lock lk(_mx);
             if (_queue.empty()) {
                 _awaiters.emplace(std::move(promise));
+                _wait_stamps.push();
             } else {
                 if constexpr(!std::is_void_v<T>) {
                     promise(std::move(_queue.front()));
@@ -211,6 +226,33 @@ public:
         };
     }
 
+    ///pop the item from the queue if there is any, doesn't wait
+    /**
+     * @return std::optional with the item, or empty optional when queue is empty. For
+     * queue<void> returns bool, true if an item has been removed
+     *
+     * @code
+     * while (auto item = q.try_pop()) {
+     *      process(*item);
+     * }
+     * @endcode
+     */
+    auto try_pop() {
+        std::lock_guard _(_mx);
+        if constexpr(std::is_void_v<T>) {
+            if (_queue.empty()) return false;
+            _queue.pop();
+            return true;
+        } else {
+            std::optional<T> out;
+            if (!_queue.empty()) {
+                out.emplace(std::move(_queue.front()));
+                _queue.pop();
+            }
+            return out;
+        }
+    }
+
     ///unblock awaiting coroutine which awaits on pop() with an exception
     /**
      * Useful to implement timeouts
@@ -225,17 +267,51 @@ public:
         if (_awaiters.empty()) return false;
         promise<T> p = std::move(_awaiters.front());
         _awaiters.pop();
+        _wait_stamps.pop(instrumentation::histogram::queue_wait_time);
         lk.unlock();
         return p.set_exception(e);        
     }
 
+    ///Arm the waiter of select() to receive an item
+    /**
+     * If there is an item, the waiter claims its select and takes the item. Otherwise
+     * the waiter is registered and it is served by the next push() after awaiting coroutines
+     * @param w waiter bound to a select
+     */
+    void arm_pop(pop_waiter &w) {
+        std::unique_lock lk(_mx);
+        if (_queue.empty()) {
+            _select_waiters.push_back(&w);
+            return;
+        }
+        if (!w.claim()) return;
+        if constexpr(std::is_void_v<T>) {
+            w._value.emplace();
+        } else {
+            w._value.emplace(std::move(_queue.front()));
+        }
+        _queue.pop();
+        lk.unlock();
+        w.notify();
+    }
+
+    ///Remove the waiter of select() if it is still registered
+    void disarm_pop(pop_waiter &w) {
+        std::lock_guard _(_mx);
+        _select_waiters.remove(&w);
+    }
+
 
 protected:
-    Lock _mx;
+    COCLS_CONTENDED Lock _mx;
     ///queue itself
     Queue<T> _queue;
     ///list of awaiters - in queue
     CoroQueue<promise<T> > _awaiters;
+    ///time stamps of awaiters (instrumentation)
+    [[no_unique_address]] instrumentation::stamp_queue _wait_stamps;
+    ///waiters of select()
+    _details::select_list<pop_waiter> _select_waiters;
 };
 
 ///Awaitable queue - limited
@@ -276,21 +352,56 @@ public:
         if (!this->_awaiters.empty()) {
             promise<T> p = std::move(this->_awaiters.front());
             this->_awaiters.pop();
+            this->_wait_stamps.pop(instrumentation::histogram::queue_wait_time);
             lk.unlock();
             p(std::forward<Args>(args)...);
             return future<void>::set_value();
+        } else if (this->_queue.size() >= _limit) {
+            //the item is inserted once a space is available
+            return [&](auto promise) {
+                _blocked.push({T(std::forward<Args>(args)...),std::move(promise)});
+            };
         } else {
             this->_queue.emplace(std::forward<Args>(args)...);
-            if (this->_queue.size() >= _limit) {
-                return [&](auto promise) {
-                    _blocked.push({T(std::forward<Args>(args)...),std::move(promise)});
-                };
-            } else {
-                return future<void>::set_value();
-            }
+            return future<void>::set_value();
         }
     }
 
+    ///type of waiter used by select() to push an item
+    using push_waiter = select_waiter<T>;
+
+    ///Arm the waiter of select() to push an item
+    /**
+     * If there is a space, the waiter claims its select and pushes the item carried
+     * in the waiter. Otherwise the waiter is registered and it is served after
+     * blocked producers, when a space is available
+     * @param w waiter bound to a select, it carries the item
+     */
+    void arm_push(push_waiter &w) {
+        std::unique_lock lk(this->_mx);
+        if (!this->_awaiters.empty()) {
+            if (!w.claim()) return;
+            promise<T> p = std::move(this->_awaiters.front());
+            this->_awaiters.pop();
+            this->_wait_stamps.pop(instrumentation::histogram::queue_wait_time);
+            lk.unlock();
+            p(std::move(*w._value));
+            w.notify();
+        } else if (this->_queue.size() >= _limit) {
+            _select_push.push_back(&w);
+        } else if (w.claim()) {
+            this->_queue.emplace(std::move(*w._value));
+            lk.unlock();
+            w.notify();
+        }
+    }
+
+    ///Remove the waiter of select() if it is still registered
+    void disarm_push(push_waiter &w) {
+        std::lock_guard _(this->_mx);
+        _select_push.remove(&w);
+    }
+
     using queue<T, Queue, CoroQueue, Lock>::size;
     using queue<T, Queue, CoroQueue, Lock>::empty;
 
@@ -300,6 +411,7 @@ public:
             std::unique_lock lk(this->_mx);
             if (this->_queue.empty()) {
                 this->_awaiters.emplace(std::move(promise));
+                this->_wait_stamps.push();
             } else {
                 if constexpr(!std::is_void_v<T>) {
                     promise(std::move(this->_queue.front()));
@@ -314,9 +426,17 @@ public:
                     _blocked.pop();
                     lk.unlock();
                     p();
-                } else {
-                    lk.unlock();
+                    return;
+                }
+                while (push_waiter *w = _select_push.pop_front()) {
+                    if (w->claim()) {
+                        this->_queue.emplace(std::move(*w->_value));
+                        lk.unlock();
+                        w->notify();
+                        return;
+                    }
                 }
+                lk.unlock();
             }
         };
     }
@@ -346,6 +466,7 @@ public:
 protected:
     BlockedQueue<std::pair<T, promise<void> > > _blocked;
     std::size_t _limit;
+    _details::select_list<push_waiter> _select_push;
 };
 
 
@@ -0,0 +1,623 @@
+/**
+ * @file reactor.h
+ *
+ * I/O reactor based on epoll (Linux only)
+ */
+#pragma once
+#ifndef SRC_cocls_REACTOR_H_
+#define SRC_cocls_REACTOR_H_
+
+#ifdef __linux__
+
+#include "exceptions.h"
+#include "future.h"
+#include "scheduler.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace cocls {
+
+///Reactor - resumes coroutines waiting for I/O on file descriptors (sockets, pipes)
+/**
+ * The reactor uses epoll to monitor file descriptors. Every operation returns a future,
+ * which can be co_awaited. The future lives in the frame of the awaiting coroutine, and
+ * the reactor keeps only the promise, so operations without timeout don't allocate memory
+ * (except the first use of the particular file descriptor)
+ *
+ * @code
+ * reactor r;
+ * r.start_in(pool);
+ *
+ * async<void> echo(reactor &r, int fd) {
+ *      char buff[1024];
+ *      for(;;) {
+ *          std::size_t sz = co_await r.read(fd, buff);
+ *          if (sz == 0) break;
+ *          co_await r.write(fd, std::span<const char>(buff, sz));
+ *      }
+ * }
+ * @endcode
+ *
+ * The reactor needs a thread, which runs its loop. It can run in a thread of the
+ * thread_pool (start_in(thread_pool &)), where the loop occupies one worker and
+ * resumed coroutines are transferred to other workers. It can also run in a
+ * dedicated thread (start_in(std::thread &)), or in current thread (run()). The
+ * function run(scheduler &) runs the loop and serves the scheduler in the same thread.
+ *
+ * Timeouts are implemented by the scheduler, which must be passed to the constructor.
+ * When timeout expires, the operation is finished with await_timeout_exception.
+ *
+ * Only one coroutine can wait for reading and one for writing on the same file descriptor
+ * at the same time. Otherwise, the operation fails with std::system_error(EBUSY)
+ *
+ * @note file descriptors must be in non-blocking mode. See set_nonblocking().
+ * @note write to a socket, which was closed by the peer, raises SIGPIPE. Applications usually
+ * ignore this signal
+ */
+class reactor {
+public:
+
+    using time_point = std::chrono::system_clock::time_point;
+
+    ///Construct the reactor without support of timeouts
+    reactor() {
+        init();
+    }
+
+    ///Construct the reactor with support of timeouts
+    /**
+     * @param sch scheduler which handles timeouts. It can run anywhere, or it can
+     * be served by the reactor, see run(scheduler &)
+     */
+    reactor(scheduler &sch):_sch(&sch) {
+        init();
+    }
+
+    reactor(const reactor &) = delete;
+    reactor &operator=(const reactor &) = delete;
+
+    ///Destroy the reactor
+    /**
+     * Stops the loop and waits for its exit. Pending operations are dropped.
+     */
+    ~reactor() {
+        stop();
+        int r = _running.load();
+        while (r) {
+            _running.wait(r);
+            r = _running.load();
+        }
+        for (auto &s: _fds) {
+            cancel_timer(s._rd);
+            cancel_timer(s._wr);
+        }
+        ::close(_evfd);
+        ::close(_epfd);
+    }
+
+    ///Switch the file descriptor to non-blocking mode
+    static void set_nonblocking(int fd) {
+        int flags = fcntl(fd, F_GETFL);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+            throw std::system_error(errno, std::generic_category(), "fcntl");
+        }
+    }
+
+    ///Wait until the file descriptor is readable
+    /**
+     * @param fd file descriptor
+     * @return future, which is resolved when the file descriptor is readable, or
+     * when it is closed or has an error (so the next read() reports the state)
+     */
+    future<void> readable(int fd) {
+        return wait_op(fd, true, time_point::max());
+    }
+
+    ///Wait until the file descriptor is readable, with timeout
+    /**
+     * @param fd file descriptor
+     * @param timeout timeout
+     * @return future, which is resolved when the file descriptor is readable. When timeout
+     * expires, the future throws await_timeout_exception
+     * @exception std::logic_error the reactor has no scheduler
+     */
+    template<typename A, typename B>
+    future<void> readable(int fd, std::chrono::duration<A,B> timeout) {
+        return wait_op(fd, true, deadline(timeout));
+    }
+
+    ///Wait until the file descriptor is writable
+    /**
+     * @param fd file descriptor
+     * @return future, which is resolved when the file descriptor is writable
+     */
+    future<void> writable(int fd) {
+        return wait_op(fd, false, time_point::max());
+    }
+
+    ///Wait until the file descriptor is writable, with timeout
+    /**
+     * @param fd file descriptor
+     * @param timeout timeout
+     * @return future, which is resolved when the file descriptor is writable. When timeout
+     * expires, the future throws await_timeout_exception
+     * @exception std::logic_error the reactor has no scheduler
+     */
+    template<typename A, typename B>
+    future<void> writable(int fd, std::chrono::duration<A,B> timeout) {
+        return wait_op(fd, false, deadline(timeout));
+    }
+
+    ///Read data
+    /**
+     * Reads data immediately if they are available, otherwise waits for data
+     *
+     * @param fd file descriptor
+     * @param buffer buffer. It must stay valid until the operation completes
+     * @return future with count of bytes read. Zero is returned at the end of stream.
+     * In case of error, the future throws std::system_error
+     */
+    future<std::size_t> read(int fd, std::span<char> buffer) {
+        return io_op(fd, true, buffer.data(), buffer.size(), time_point::max());
+    }
+
+    ///Read data, with timeout
+    /**
+     * @param fd file descriptor
+     * @param buffer buffer. It must stay valid until the operation completes
+     * @param timeout timeout
+     * @return future with count of bytes read. When timeout expires, the future
+     * throws await_timeout_exception
+     * @exception std::logic_error the reactor has no scheduler
+     */
+    template<typename A, typename B>
+    future<std::size_t> read(int fd, std::span<char> buffer, std::chrono::duration<A,B> timeout) {
+        return io_op(fd, true, buffer.data(), buffer.size(), deadline(timeout));
+    }
+
+    ///Write data
+    /**
+     * Writes data immediately if possible, otherwise waits until the file descriptor
+     * is writable
+     *
+     * @param fd file descriptor
+     * @param buffer data to write. It must stay valid until the operation completes
+     * @return future with count of bytes written. It can be less than size of the
+     * buffer. In case of error, the future throws std::system_error
+     */
+    future<std::size_t> write(int fd, std::span<const char> buffer) {
+        return io_op(fd, false, const_cast<char *>(buffer.data()), buffer.size(), time_point::max());
+    }
+
+    ///Write data, with timeout
+    /**
+     * @param fd file descriptor
+     * @param buffer data to write. It must stay valid until the operation completes
+     * @param timeout timeout
+     * @return future with count of bytes written. When timeout expires, the future
+     * throws await_timeout_exception
+     * @exception std::logic_error the reactor has no scheduler
+     */
+    template<typename A, typename B>
+    future<std::size_t> write(int fd, std::span<const char> buffer, std::chrono::duration<A,B> timeout) {
+        return io_op(fd, false, const_cast<char *>(buffer.data()), buffer.size(), deadline(timeout));
+    }
+
+    ///Cancel all operations on the file descriptor
+    /**
+     * Pending operations throw await_canceled_exception. The file descriptor is also removed
+     * from the epoll. Call this function before the file descriptor is closed, if there
+     * can be a pending operation.
+     *
+     * @param fd file descriptor
+     * @return suspend_point, which resumes canceled coroutines
+     */
+    suspend_point<void> cancel(int fd) {
+        op rd, wr;
+        {
+            std::lock_guard _(_mx);
+            if (fd < 0 || static_cast<std::size_t>(fd) >= _fds.size()) return {};
+            fd_slot &s = _fds[fd];
+            rd = take(s._rd);
+            wr = take(s._wr);
+            if (s._registered) {
+                epoll_ctl(_epfd, EPOLL_CTL_DEL, fd, nullptr);
+                s._registered = false;
+            }
+        }
+        auto e = std::make_exception_ptr(await_canceled_exception());
+        suspend_point<void> sp;
+        sp << fail(rd, e);
+        sp << fail(wr, e);
+        return sp;
+    }
+
+    ///Run the reactor's loop in the current thread
+    /**
+     * Function returns after stop() is called. Coroutines are resumed in this thread
+     */
+    void run() {
+        enter();
+        std::unique_ptr<reactor, leave_fn> guard(this);
+        run_loop(nullptr, nullptr);
+    }
+
+    ///Run the reactor's loop in the current thread and serve the scheduler in the same thread
+    /**
+     * The scheduler must not be started in other thread. The loop waits for I/O events
+     * and for expiration of scheduled tasks, so one thread serves both I/O and timers.
+     *
+     * @param sch scheduler
+     */
+    void run(scheduler &sch) {
+        enter();
+        std::unique_ptr<reactor, leave_fn> guard(this);
+        sch.set_wakeup([this]{wakeup();});
+        try {
+            run_loop(nullptr, &sch);
+        } catch (...) {
+            sch.set_wakeup({});
+            throw;
+        }
+        sch.set_wakeup({});
+    }
+
+    ///Start the reactor's loop in the thread pool
+    /**
+     * The loop occupies one worker of the thread pool. Resumed coroutines are
+     * enqueued to the thread pool
+     *
+     * @param pool thread pool
+     */
+    void start_in(thread_pool &pool) {
+        enter();
+        pool.run_detached([guard = std::unique_ptr<reactor, leave_fn>(this), &pool]{
+            guard->run_loop(&pool, nullptr);
+        });
+    }
+
+    ///Start the reactor's loop in a new thread
+    /**
+     * @param thr thread object, which receives the new thread. You need to join or
+     * detach it
+     */
+    void start_in(std::thread &thr) {
+        enter();
+        thr = std::thread([this]{
+            std::unique_ptr<reactor, leave_fn> guard(this);
+            run_loop(nullptr, nullptr);
+        });
+    }
+
+    ///Stop the reactor's loop
+    /**
+     * Stopped reactor cannot be restarted
+     */
+    void stop() {
+        _exit.store(true, std::memory_order_release);
+        wakeup();
+    }
+
+protected:
+
+    enum class op_kind {none, wait, read, write};
+
+    //pending operation, it is stored in the slot of file descriptor
+    struct op {
+        op_kind _kind = op_kind::none;
+        promise<void> _ready;
+        promise<std::size_t> _io;
+        char *_buffer = nullptr;
+        std::size_t _size = 0;
+        //sequence number - identifies the operation for the timer
+        std::uint64_t _seq = 0;
+        bool _timer = false;
+    };
+
+    struct fd_slot {
+        op _rd;
+        op _wr;
+        bool _registered = false;
+    };
+
+    struct leave_fn {
+        void operator()(reactor *r) const noexcept {r->leave();}
+    };
+
+    static constexpr int max_events = 64;
+
+    int _epfd = -1;
+    int _evfd = -1;
+    scheduler *_sch = nullptr;
+    std::mutex _mx;
+    //slots indexed by file descriptor, deque keeps references valid while growing
+    std::deque<fd_slot> _fds;
+    std::uint64_t _seq = 0;
+    std::atomic<bool> _exit = false;
+    std::atomic<int> _running = 0;
+
+    void init() {
+        _epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (_epfd < 0) throw std::system_error(errno, std::generic_category(), "epoll_create1");
+        _evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (_evfd < 0) {
+            int e = errno;
+            ::close(_epfd);
+            throw std::system_error(e, std::generic_category(), "eventfd");
+        }
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = _evfd;
+        epoll_ctl(_epfd, EPOLL_CTL_ADD, _evfd, &ev);
+    }
+
+    void enter() {
+        _running.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void leave() {
+        if (_running.fetch_sub(1, std::memory_order_release) == 1) {
+            _running.notify_all();
+        }
+    }
+
+    void wakeup() {
+        std::uint64_t v = 1;
+        [[maybe_unused]] auto r = ::write(_evfd, &v, sizeof(v));
+    }
+
+    template<typename A, typename B>
+    time_point deadline(std::chrono::duration<A,B> timeout) {
+        if (_sch == nullptr) throw std::logic_error("Timeout requires a scheduler");
+        return std::chrono::system_clock::now() + std::chrono::duration_cast<std::chrono::system_clock::duration>(timeout);
+    }
+
+    static op take(op &o) {
+        op r = std::move(o);
+        o._kind = op_kind::none;
+        o._timer = false;
+        return r;
+    }
+
+    //converts sequence number to scheduler's identifier
+    /* Odd values never collide with addresses of variables used as identifiers by others */
+    static scheduler::ident timer_ident(std::uint64_t seq) {
+        return reinterpret_cast<scheduler::ident>(static_cast<std::uintptr_t>((seq << 1) | 1));
+    }
+
+    //must be called under lock
+    fd_slot &slot(int fd) {
+        if (static_cast<std::size_t>(fd) >= _fds.size()) _fds.resize(fd+1);
+        return _fds[fd];
+    }
+
+    //arm epoll for pending operations, must be called under lock
+    int arm(int fd, fd_slot &s) {
+        epoll_event ev = {};
+        ev.events = EPOLLONESHOT;
+        if (s._rd._kind != op_kind::none) ev.events |= EPOLLIN | EPOLLRDHUP;
+        if (s._wr._kind != op_kind::none) ev.events |= EPOLLOUT;
+        ev.data.fd = fd;
+        if (s._registered) {
+            if (epoll_ctl(_epfd, EPOLL_CTL_MOD, fd, &ev) == 0) return 0;
+            if (errno != ENOENT) return errno;
+            //file descriptor has been closed and reused
+        }
+        if (epoll_ctl(_epfd, EPOLL_CTL_ADD, fd, &ev)) {
+            if (errno != EEXIST || epoll_ctl(_epfd, EPOLL_CTL_MOD, fd, &ev)) return errno;
+        }
+        s._registered = true;
+        return 0;
+    }
+
+    future<void> wait_op(int fd, bool rd, time_point tp) {
+        return [&](auto promise) {
+            op o;
+            o._kind = op_kind::wait;
+            o._ready = std::move(promise);
+            add_op(fd, rd, std::move(o), tp);
+        };
+    }
+
+    future<std::size_t> io_op(int fd, bool rd, char *buffer, std::size_t size, time_point tp) {
+        return [&](auto promise) {
+            //try to perform operation now
+            auto r = rd ? ::read(fd, buffer, size) : ::write(fd, buffer, size);
+            if (r >= 0) {
+                promise(static_cast<std::size_t>(r));
+                return;
+            }
+            int e = errno;
+            if (e != EAGAIN && e != EWOULDBLOCK && e != EINTR) {
+                promise.set_exception(std::make_exception_ptr(std::system_error(e, std::generic_category(), rd?"read":"write")));
+                return;
+            }
+            op o;
+            o._kind = rd?op_kind::read:op_kind::write;
+            o._io = std::move(promise);
+            o._buffer = buffer;
+            o._size = size;
+            add_op(fd, rd, std::move(o), tp);
+        };
+    }
+
+    void add_op(int fd, bool rd, op &&o, time_point tp) {
+        std::unique_lock lk(_mx);
+        fd_slot &s = slot(fd);
+        op &target = rd?s._rd:s._wr;
+        int err = EBUSY;
+        if (target._kind == op_kind::none) {
+            o._seq = ++_seq;
+            o._timer = _sch != nullptr && tp != time_point::max();
+            target = std::move(o);
+            err = arm(fd, s);
+            if (!err) {
+                if (target._timer) {
+                    std::uint64_t seq = target._seq;
+                    lk.unlock();
+                    //scheduler resolves promises under its lock, so timer is scheduled outside of our lock
+                    _sch->schedule(timer_ident(seq), make_promise<void>([this, fd, rd, seq](future<void> &f){
+                        //dropped promise means, that the timer has been removed
+                        if (f.has_value()) on_timeout(fd, rd, seq);
+                    }), tp);
+                }
+                return;
+            }
+            o = take(target);
+        }
+        lk.unlock();
+        fail(o, std::make_exception_ptr(std::system_error(err, std::generic_category(), "epoll_ctl")));
+    }
+
+    void cancel_timer(op &o) {
+        if (o._timer) {
+            o._timer = false;
+            //removed promise is dropped, so the timer's callback does nothing
+            _sch->remove(timer_ident(o._seq));
+        }
+    }
+
+    suspend_point<void> fail(op &o, std::exception_ptr e) {
+        cancel_timer(o);
+        switch (o._kind) {
+            case op_kind::wait: return o._ready.set_exception(std::move(e));
+            case op_kind::read:
+            case op_kind::write: return o._io.set_exception(std::move(e));
+            default: return {};
+        }
+    }
+
+    void on_timeout(int fd, bool rd, std::uint64_t seq) {
+        op o;
+        {
+            std::lock_guard _(_mx);
+            fd_slot &s = _fds[fd];
+            op &target = rd?s._rd:s._wr;
+            if (target._kind == op_kind::none || target._seq != seq) return;
+            o = take(target);
+            arm(fd, s);
+        }
+        //the timer has just fired, called under scheduler's lock, so it must not be removed
+        o._timer = false;
+        fail(o, std::make_exception_ptr(await_timeout_exception()));
+    }
+
+    //perform the operation, after the file descriptor is signaled
+    suspend_point<void> perform(int fd, bool rd, op &o) {
+        switch (o._kind) {
+            default: return {};
+            case op_kind::wait:
+                cancel_timer(o);
+                return o._ready();
+            case op_kind::read:
+            case op_kind::write: {
+                auto r = o._kind == op_kind::read ? ::read(fd, o._buffer, o._size) : ::write(fd, o._buffer, o._size);
+                if (r >= 0) {
+                    cancel_timer(o);
+                    return o._io(static_cast<std::size_t>(r));
+                }
+                int e = errno;
+                if (e == EAGAIN || e == EWOULDBLOCK || e == EINTR) {
+                    //spurious wakeup, wait again
+                    std::unique_lock lk(_mx);
+                    fd_slot &s = _fds[fd];
+                    op &target = rd?s._rd:s._wr;
+                    if (target._kind == op_kind::none) {
+                        target = take(o);
+                        arm(fd, s);
+                        return {};
+                    }
+                    //other operation has been registered meanwhile
+                    lk.unlock();
+                    e = EBUSY;
+                }
+                return fail(o, std::make_exception_ptr(std::system_error(e, std::generic_category(), rd?"read":"write")));
+            }
+        }
+    }
+
+    suspend_point<void> dispatch(int fd, std::uint32_t events) {
+        op rd, wr;
+        {
+            std::lock_guard _(_mx);
+            fd_slot &s = _fds[fd];
+            bool err = (events & (EPOLLERR | EPOLLHUP)) != 0;
+            if (err || (events & (EPOLLIN | EPOLLRDHUP))) rd = take(s._rd);
+            if (err || (events & EPOLLOUT)) wr = take(s._wr);
+            //rearm for the other direction (EPOLLONESHOT)
+            if (s._rd._kind != op_kind::none || s._wr._kind != op_kind::none) arm(fd, s);
+        }
+        suspend_point<void> sp;
+        sp << perform(fd, true, rd);
+        sp << perform(fd, false, wr);
+        return sp;
+    }
+
+    void run_loop(thread_pool *pool, scheduler *sch) {
+        epoll_event events[max_events];
+        while (!_exit.load(std::memory_order_acquire)) {
+            suspend_point<void> sp;
+            int timeout = -1;
+            if (sch) {
+                auto now = std::chrono::system_clock::now();
+                for (;;) {
+                    auto e = sch->get_expired(now);
+                    if (std::holds_alternative<scheduler::promise>(e)) {
+                        sp << std::get<scheduler::promise>(e)();
+                    } else {
+                        auto tp = std::get<time_point>(e);
+                        if (tp != time_point::max()) {
+                            auto ms = std::chrono::ceil<std::chrono::milliseconds>(tp - now).count();
+                            timeout = static_cast<int>(std::clamp<decltype(ms)>(ms, 0, INT_MAX));
+                        }
+                        break;
+                    }
+                }
+                if (!sp.empty()) {
+                    //resume expired tasks first, they can schedule new tasks
+                    sp.clear();
+                    continue;
+                }
+            }
+            int n = epoll_wait(_epfd, events, max_events, timeout);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::system_error(errno, std::generic_category(), "epoll_wait");
+            }
+            for (int i = 0; i < n; i++) {
+                int fd = events[i].data.fd;
+                if (fd == _evfd) {
+                    std::uint64_t v;
+                    [[maybe_unused]] auto r = ::read(_evfd, &v, sizeof(v));
+                } else {
+                    sp << dispatch(fd, events[i].events);
+                }
+            }
+            if (pool) pool->resume(sp);
+            else sp.clear();
+        }
+    }
+};
+
+}
+
+#endif
+
+#endif /* SRC_cocls_REACTOR_H_ */
@@ -0,0 +1,80 @@
+/**
+ * @file resumption_policy.h
+ *
+ * Compile time policies, which define how a finished async<> coroutine
+ * resumes coroutines awaiting its result
+ */
+#pragma once
+#ifndef SRC_cocls_RESUMPTION_POLICY_H_
+#define SRC_cocls_RESUMPTION_POLICY_H_
+
+#include <type_traits>
+
+namespace cocls {
+
+class awaiter;
+
+///Resumption policies of async<T, Policy>
+/**
+ * The policy is a part of the type of the coroutine, so it is resolved during
+ * compilation. There is no runtime branch nor virtual call
+ *
+ * @code
+ * cocls::thread_pool pool;
+ *
+ * cocls::async<int, cocls::resumption_policy::executor<pool> > calc() {
+ *      ...
+ *      co_return 42;   //awaiting coroutine continues in the pool
+ * }
+ * @endcode
+ */
+namespace resumption_policy {
+
+    ///Awaiting coroutine is resumed by symmetric transfer (default)
+    /**
+     * Other coroutines, which are woken up by the result, are resumed through
+     * the coro_queue
+     */
+    struct immediate {};
+
+    ///All awaiting coroutines are resumed through the coro_queue of current thread
+    /**
+     * Coroutines which are already in the queue are resumed first. This prevents
+     * long chains of symmetric transfers, and it is more fair for coroutines
+     * which share the thread
+     */
+    struct queued {};
+
+    ///The result is set and awaiting coroutines are resumed in the executor
+    /**
+     * @tparam Executor reference to the executor. It must have static storage duration
+     * and function post(awaiter *), for example thread_pool or strand
+     *
+     * @note You can define own policy, any class with static function post(awaiter *)
+     * is considered as a posting policy
+     */
+    template<auto &Executor>
+    struct executor {
+        static void post(awaiter *awt) {
+            Executor.post(awt);
+        }
+    };
+
+}
+
+namespace _details {
+
+    template<typename Policy, typename = void>
+    struct is_posting_policy: std::false_type {};
+
+    template<typename Policy>
+    struct is_posting_policy<Policy, std::void_t<decltype(Policy::post(static_cast<awaiter *>(nullptr)))> >: std::true_type {};
+
+}
+
+template<typename T, typename Policy = resumption_policy::immediate> class async;
+template<typename T, typename Policy = resumption_policy::immediate> class async_promise;
+
+}
+
+#endif /* SRC_cocls_RESUMPTION_POLICY_H_ */
@@ -14,6 +14,8 @@
 #include "generator.h"
 
 #include "coro_queue.h"
+#include "coro_registry.h"
+#include "instrumentation.h"
 
 #include <condition_variable>
 #include <functional>
@@ -91,11 +93,27 @@ public:
           bool ntf = _scheduled.empty() || _scheduled[0]._tp > tp;
           _scheduled.push_back({tp, std::move(p), id});
           std::push_heap(_scheduled.begin(), _scheduled.end(), compare_item);
+          instrumentation::record(instrumentation::histogram::scheduler_timers, _scheduled.size());
           if (ntf) {
               _cond.notify_all();
+              if (_wakeup) _wakeup();
           }
       }
 
+    ///Sets function, which is called when a task is scheduled before the nearest expiration
+    /**
+     * This allows to drive the scheduler from an external event loop (for example the reactor)
+     * by calling get_expired(). The loop needs to be woken up, when nearest expiration
+     * changes.
+     *
+     * @param fn function to call. Pass empty function to remove it. The function is
+     * called under internal lock, so it must not call the scheduler.
+     */
+    void set_wakeup(function<void()> fn) {
+        std::lock_guard _(_mx);
+        _wakeup = std::move(fn);
+    }
+
     ///Retrieves first expired promise or calculates time-point of first expiration
     /**
      * Useful for manual scheduling. If there is expired promise, it is removed and returned.
@@ -329,6 +347,44 @@ public:
     }
 
 
+    ///Start watchdog, which periodically reports coroutines suspended for too long
+    /**
+     * Requires COCLS_CORO_REGISTRY, otherwise nothing is reported.
+     *
+     * @param threshold report coroutines suspended longer than threshold
+     * @param period period of checks
+     * @param report function called with list of coroutines (std::vector<coro_info>) when
+     * the list is not empty
+     * @param token stop token to stop the watchdog
+     * @return coroutine, which must be started (usually detached)
+     *
+     * @code
+     * sch.watchdog(std::chrono::seconds(30), std::chrono::seconds(5), [](const auto &lst){
+     *      for (const coro_info &nfo: lst) log_stuck(nfo);
+     * }, stop.get_token()).detach();
+     * @endcode
+     */
+    template<typename A, typename B, typename C, typename D, typename Fn>
+    async<void> watchdog(std::chrono::duration<A,B> threshold, std::chrono::duration<C,D> period, Fn report, std::stop_token token = {}) {
+        bool tag;
+        std::stop_callback stpc(token,[&]{
+            this->cancel(&tag);
+        });
+        future<void> waiter;
+        try {
+            while (!token.stop_requested()) {
+                waiter << [&]{return this->sleep_for(period, &tag);};
+                co_await waiter;
+                auto lst = coro_registry::stuck(threshold);
+                //don't report the watchdog itself
+                std::erase_if(lst, [&](const coro_info &nfo){return nfo.awaiting == &waiter;});
+                if (!lst.empty()) report(lst);
+            }
+        } catch (const await_canceled_exception &) {
+            //empty
+        }
+    }
+
     ~scheduler() {
         if (_glob_state.has_value()) {
             _glob_state->_stp.request_stop();
@@ -358,6 +414,7 @@ protected:
     std::condition_variable _cond;
     std::optional<GlobState> _glob_state;
     std::size_t _elide_state = 0;
+    function<void()> _wakeup;
 
 
     static bool compare_item(const SchItem &a, const SchItem &b) {
@@ -417,8 +474,11 @@ protected:
     expired get_expired_lk(std::chrono::system_clock::time_point now) {
         while (!_scheduled.empty() && (_scheduled[0]._tp <= now || !_scheduled[0]._p)) {
             promise p ( std::move(_scheduled[0]._p));
+            auto tp = _scheduled[0]._tp;
             pop_item();
             if (p) {
+                instrumentation::record(instrumentation::histogram::scheduler_lateness,
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(now - tp).count());
                 return p;
             }
         }
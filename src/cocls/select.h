@@ -0,0 +1,335 @@
+/**
+ * @file select.h
+ *
+ * Awaiting multiple sources at once, whichever is ready first
+ */
+#pragma once
+#ifndef SRC_cocls_SELECT_H_
+#define SRC_cocls_SELECT_H_
+
+#include "awaiter.h"
+#include "exceptions.h"
+#include "future.h"
+#include "queue.h"
+#include "scheduler.h"
+#include "select_state.h"
+#include "signal.h"
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <variant>
+
+namespace cocls {
+
+/*
+ * Every case of select() implements
+ *
+ * using value_type = ...;                          - result of the case (never void)
+ * void arm(_details::select_state &st, int idx);   - register to the source, or complete immediately
+ * void disarm();                                   - unregister from the source (case lost)
+ * value_type get_result();                         - retrieve result (case won)
+ *
+ * Cases are movable until they are armed
+ */
+
+///Case of select(), which pops an item from the queue
+/**
+ * @tparam Queue type of queue (cocls::queue)
+ *
+ * Waiters of select() are served after coroutines which are waiting on pop()
+ */
+template<typename Queue>
+class pop_case {
+public:
+    ///result is the item (std::monostate for queue<void>)
+    using value_type = select_value_t<typename Queue::value_type>;
+
+    explicit pop_case(Queue &q):_q(q) {}
+    pop_case(pop_case &&other):_q(other._q) {}
+
+    void arm(_details::select_state &st, int idx) {
+        _w.bind(st, idx);
+        _q.arm_pop(_w);
+    }
+    void disarm() {
+        _q.disarm_pop(_w);
+    }
+    value_type get_result() {
+        return std::move(*_w._value);
+    }
+
+protected:
+    Queue &_q;
+    typename Queue::pop_waiter _w;
+};
+
+///Case of select(), which pushes an item to the limited queue
+/**
+ * @tparam Queue type of queue (cocls::limited_queue)
+ *
+ * The case is ready, when there is space in the queue. When the case is not
+ * selected, the item is not pushed
+ */
+template<typename Queue>
+class push_case {
+public:
+    using value_type = std::monostate;
+
+    template<typename ... Args>
+    explicit push_case(Queue &q, Args && ... args):_q(q) {
+        _w._value.emplace(std::forward<Args>(args)...);
+    }
+    push_case(push_case &&other):_q(other._q) {
+        _w._value = std::move(other._w._value);
+    }
+
+    void arm(_details::select_state &st, int idx) {
+        _w.bind(st, idx);
+        _q.arm_push(_w);
+    }
+    void disarm() {
+        _q.disarm_push(_w);
+    }
+    value_type get_result() {
+        return {};
+    }
+
+protected:
+    Queue &_q;
+    typename Queue::push_waiter _w;
+};
+
+///Case of select(), which receives next signal
+/**
+ * @tparam T type of the signal. The case receives a copy of the value
+ *
+ * @note the case doesn't keep the signal alive. If the signal is destroyed while the
+ * case is armed, or it is no longer available when the case is armed, the case
+ * is selected and throws await_canceled_exception
+ */
+template<typename T>
+class signal_case {
+public:
+    using value_type = typename signal<T>::select_type;
+
+    explicit signal_case(const signal<T> &sig):_wk_state(sig._state) {}
+    explicit signal_case(const typename signal<T>::emitter &em):_wk_state(em._wk_state) {}
+    signal_case(signal_case &&other):_wk_state(std::move(other._wk_state)) {}
+
+    void arm(_details::select_state &st, int idx) {
+        _w.bind(st, idx);
+        auto state = _wk_state.lock();
+        if (state) {
+            state->arm_select(_w);
+        } else {
+            //not registered, so it is already released
+            _w._next = &_w;
+            if (_w.claim()) _w.notify();
+        }
+    }
+    void disarm() {
+        auto state = _wk_state.lock();
+        if (state) {
+            state->disarm_select(_w);
+        } else {
+            //the signal is being destroyed, wait until it releases the waiter
+            std::atomic_ref<select_waiter<value_type> *> next(_w._next);
+            while (next.load(std::memory_order_acquire) != &_w) cpu_relax();
+        }
+    }
+    value_type get_result() {
+        if (!_w._value.has_value()) throw await_canceled_exception();
+        return std::move(*_w._value);
+    }
+
+protected:
+    std::weak_ptr<typename signal<T>::state> _wk_state;
+    select_waiter<value_type> _w;
+};
+
+template<typename T>
+signal_case(const signal<T> &) -> signal_case<T>;
+
+///Case of select(), which is selected when the time-point is reached
+/**
+ * The case uses sleep_until() of the scheduler. When the case is not selected, the
+ * sleep is canceled
+ */
+class timeout_case: public awaiter {
+public:
+    using value_type = std::monostate;
+    using time_point = std::chrono::system_clock::time_point;
+
+    timeout_case(scheduler &sch, time_point tp):_sch(sch),_tp(tp) {}
+    template<typename A, typename B>
+    timeout_case(scheduler &sch, std::chrono::duration<A, B> dur)
+        :_sch(sch),_tp(std::chrono::system_clock::now()
+                +std::chrono::duration_cast<std::chrono::system_clock::duration>(dur)) {}
+    timeout_case(timeout_case &&other):awaiter(),_sch(other._sch),_tp(other._tp) {}
+
+    void arm(_details::select_state &st, int idx) {
+        _state = &st;
+        _index = idx;
+        set_resume_fn(&on_timeout);
+        _f << [&]{return _sch.sleep_until(_tp, this);};
+        if (!_f.subscribe(this)) resume();
+    }
+    void disarm() {
+        _sch.cancel(this);
+        //the callback can be deferred by this thread (deep resume), it is not needed
+        if (_fired.load(std::memory_order_acquire) || cancel_deferred()) return;
+        //the scheduler is resolving the sleep right now in other thread
+        while (!_fired.load(std::memory_order_acquire)) cpu_relax();
+    }
+    value_type get_result() {
+        _f.value();
+        return {};
+    }
+
+protected:
+    scheduler &_sch;
+    time_point _tp;
+    _details::select_state *_state = nullptr;
+    int _index = 0;
+    std::atomic<bool> _fired = false;
+    future<void> _f;
+
+    static suspend_point<void> on_timeout(awaiter *me, void *) noexcept {
+        auto _this = static_cast<timeout_case *>(me);
+        auto st = _this->_state;
+        bool won = st->claim(_this->_index);
+        _this->_fired.store(true, std::memory_order_release);
+        if (won) return st->notify();
+        return {};
+    }
+};
+
+///Awaiter of select()
+/**
+ * @tparam Cases cases of the select
+ *
+ * The cases are armed in order of declaration, so if multiple cases are ready,
+ * the first one is selected. Once a case is selected, the other cases are disarmed -
+ * they are removed from their sources.
+ */
+template<typename ... Cases>
+class select_awaiter: public awaiter {
+public:
+
+    ///result of select - index of the variant is index of selected case
+    using result_type = std::variant<typename Cases::value_type...>;
+
+    template<typename ... Args>
+    select_awaiter(Args && ... cases):_cases(std::forward<Args>(cases)...) {}
+    select_awaiter(const select_awaiter &) = delete;
+    select_awaiter &operator=(const select_awaiter &) = delete;
+
+    static constexpr bool await_ready() noexcept {return false;}
+
+    bool await_suspend(std::coroutine_handle<> h) {
+        set_handle(h);
+        return arm();
+    }
+
+    result_type await_resume() {
+        return finish(index_seq());
+    }
+
+    ///wait synchronously
+    result_type wait() {
+        sync_awaiter awt;
+        _sync = &awt;
+        set_resume_fn(&wakeup_sync);
+        if (arm()) awt.wait_sync();
+        return finish(index_seq());
+    }
+
+protected:
+
+    using index_seq = std::index_sequence_for<Cases...>;
+
+    std::tuple<Cases...> _cases;
+    _details::select_state _state;
+    int _armed = 0;
+    sync_awaiter *_sync = nullptr;
+
+    bool arm() {
+        _state.set_target(this);
+        arm_cases(index_seq());
+        return _state.finish_arming();
+    }
+
+    template<std::size_t ... I>
+    void arm_cases(std::index_sequence<I...>) {
+        //stops on first selected case
+        ((_state.winner() < 0 && (std::get<I>(_cases).arm(_state, static_cast<int>(I)), ++_armed, true)) && ...);
+    }
+
+    template<std::size_t I>
+    result_type get_result() {
+        return result_type(std::in_place_index<I>, std::get<I>(_cases).get_result());
+    }
+
+    template<std::size_t ... I>
+    result_type finish(std::index_sequence<I...>) {
+        int w = _state.winner();
+        ((static_cast<int>(I) < _armed && static_cast<int>(I) != w ? std::get<I>(_cases).disarm() : void()), ...);
+        using getter = result_type (select_awaiter::*)();
+        static constexpr getter table[] = {&select_awaiter::get_result<I>...};
+        return (this->*table[w])();
+    }
+
+    static suspend_point<void> wakeup_sync(awaiter *me, void *) noexcept {
+        static_cast<select_awaiter *>(me)->_sync->wakeup();
+        return {};
+    }
+};
+
+///Awaiter of single case, returns the result of the case directly
+template<typename Case>
+class case_awaiter: public select_awaiter<Case> {
+public:
+    using select_awaiter<Case>::select_awaiter;
+
+    typename Case::value_type await_resume() {
+        return std::get<0>(select_awaiter<Case>::await_resume());
+    }
+
+    ///wait synchronously
+    typename Case::value_type wait() {
+        return std::get<0>(select_awaiter<Case>::wait());
+    }
+};
+
+///Await multiple cases, whichever is ready first
+/**
+ * @param cases cases to await (pop_case, push_case, signal_case, timeout_case,
+ * recv_case, send_case)
+ * @return awaiter. The result of co_await is std::variant, where index of the
+ * active alternative is index of selected case. Exactly one case is selected,
+ * other cases don't consume anything. You can also call wait() to wait synchronously
+ *
+ * @code
+ * auto r = co_await select(pop_case(data), pop_case(control), timeout_case(sch, 1s));
+ * switch (r.index()) {
+ *      case 0: process(std::get<0>(r));break;
+ *      case 1: command(std::get<1>(r));break;
+ *      case 2: on_idle();break;
+ * }
+ * @endcode
+ *
+ * @note the cases are armed in order. If more cases are ready, the first one
+ * is selected.
+ */
+template<typename ... Cases>
+select_awaiter<std::decay_t<Cases>...> select(Cases && ... cases) {
+    return select_awaiter<std::decay_t<Cases>...>(std::forward<Cases>(cases)...);
+}
+
+}
+
+#endif /* SRC_cocls_SELECT_H_ */
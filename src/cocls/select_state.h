@@ -0,0 +1,211 @@
+/**
+ * @file select_state.h
+ *
+ * Shared state of select() and waiters registered in the sources
+ */
+#pragma once
+#ifndef SRC_cocls_SELECT_STATE_H_
+#define SRC_cocls_SELECT_STATE_H_
+
+#include "awaiter.h"
+#include "common.h"
+
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <variant>
+
+namespace cocls {
+
+///Type of value stored in the select waiter (void is replaced by std::monostate)
+template<typename T>
+using select_value_t = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+namespace _details {
+
+///State of single select operation
+/**
+ * Exactly one case of the select can be claimed. A source claims the case before
+ * it delivers the value to the waiter. Once the state is claimed, other sources
+ * see that the claim failed and they leave the waiter.
+ *
+ * The coroutine is resumed by the party which finishes later - either the claiming
+ * source after the value has been delivered, or the select itself after all
+ * cases are armed.
+ */
+class select_state {
+public:
+
+    ///state is not claimed
+    static constexpr int free = -1;
+    ///state is temporarily reserved by a rendezvous (pairing two selects)
+    static constexpr int reserved = -2;
+
+    ///result of claim of two states
+    enum class pair_result {
+        ///both states claimed
+        ok,
+        ///own state was already claimed
+        self_lost,
+        ///remote state was already claimed
+        remote_lost
+    };
+
+    ///sets awaiter which is resumed when the select is complete
+    void set_target(awaiter *target) {
+        _target = target;
+    }
+
+    ///Claim the state
+    /**
+     * @param idx index of the case
+     * @retval true claimed, caller must deliver the value and call notify()
+     * @retval false already claimed
+     */
+    bool claim(int idx) {
+        int v = free;
+        while (!_winner.compare_exchange_weak(v, idx, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            if (v >= 0) return false;
+            //reservation is short, it is either committed or released
+            if (v == reserved) cpu_relax();
+            v = free;
+        }
+        return true;
+    }
+
+    ///Claim own state and state of the other party atomically
+    /**
+     * @param self own state
+     * @param self_idx index of the case of own state
+     * @param remote state of the other party
+     * @param remote_idx index of the case of the other party
+     * @return result
+     */
+    static pair_result claim_pair(select_state &self, int self_idx, select_state &remote, int remote_idx) {
+        for (;;) {
+            int v = free;
+            if (!remote._winner.compare_exchange_strong(v, reserved, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                if (v >= 0) return pair_result::remote_lost;
+                cpu_relax();
+                continue;
+            }
+            int s = free;
+            if (self._winner.compare_exchange_strong(s, self_idx, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                remote._winner.store(remote_idx, std::memory_order_release);
+                return pair_result::ok;
+            }
+            remote._winner.store(free, std::memory_order_release);
+            if (s >= 0) return pair_result::self_lost;
+            //own state is reserved by other rendezvous, let it finish
+            std::this_thread::yield();
+        }
+    }
+
+    ///retrieves index of claimed case, or negative number, if not claimed yet
+    int winner() const {
+        return _winner.load(std::memory_order_acquire);
+    }
+
+    ///Called by the party which claimed the state after the value has been delivered
+    suspend_point<void> notify() {
+        if (_ticket.fetch_sub(1, std::memory_order_acq_rel) == 1) return _target->resume();
+        return {};
+    }
+
+    ///Called by the select after all cases are armed
+    /**
+     * @retval true select must wait
+     * @retval false select is already complete
+     */
+    bool finish_arming() {
+        return _ticket.fetch_sub(1, std::memory_order_acq_rel) != 1;
+    }
+
+protected:
+    std::atomic<int> _winner = free;
+    std::atomic<int> _ticket = 2;
+    awaiter *_target = nullptr;
+};
+
+///Singly linked FIFO list of waiters, must be protected by a lock
+template<typename Node>
+class select_list {
+public:
+
+    bool empty() const {return _first == nullptr;}
+
+    void push_back(Node *n) {
+        n->_next = nullptr;
+        *_last = n;
+        _last = &n->_next;
+    }
+
+    Node *pop_front() {
+        Node *n = _first;
+        if (n) {
+            _first = n->_next;
+            if (!_first) _last = &_first;
+        }
+        return n;
+    }
+
+    ///removes the node if it is in the list
+    void remove(Node *n) {
+        Node **p = &_first;
+        while (*p && *p != n) p = &(*p)->_next;
+        if (*p) {
+            *p = n->_next;
+            if (!*p) _last = p;
+        }
+    }
+
+    ///finds first node which satisfies the predicate
+    template<typename Pred>
+    Node *find(Pred &&pred) const {
+        Node *n = _first;
+        while (n && !pred(n)) n = n->_next;
+        return n;
+    }
+
+protected:
+    Node *_first = nullptr;
+    Node **_last = &_first;
+};
+
+}
+
+///Waiter of a select case registered in a source
+/**
+ * @tparam T type of the value delivered to the waiter (or carried by the waiter
+ * when it pushes the value)
+ */
+template<typename T>
+class select_waiter {
+public:
+
+    select_waiter() = default;
+    select_waiter(const select_waiter &) = delete;
+    select_waiter &operator=(const select_waiter &) = delete;
+
+    ///binds the waiter to the select
+    void bind(_details::select_state &state, int idx) {
+        _state = &state;
+        _index = idx;
+    }
+
+    ///claim the select for this waiter
+    bool claim() {return _state->claim(_index);}
+
+    ///notify the select after the value has been delivered
+    suspend_point<void> notify() {return _state->notify();}
+
+    _details::select_state *_state = nullptr;
+    int _index = 0;
+    select_waiter *_next = nullptr;
+    std::optional<T> _value;
+};
+
+}
+
+#endif /* SRC_cocls_SELECT_STATE_H_ */
@@ -5,15 +5,18 @@
 #include "queue.h"
 #include "exceptions.h"
 #include "function.h"
+#include "select_state.h"
 
 #include <atomic>
 #include <coroutine>
 #include <memory>
+#include <mutex>
 #include <variant>
 #include <type_traits>
 
 namespace cocls {
 
+template<typename T> class signal_case;
 
 
 
@@ -34,14 +37,51 @@ template<typename T>
 class signal {
 
     using storage_type = std::conditional_t<std::is_void_v<T>, bool , T>;
+    using select_type = select_value_t<std::remove_cvref_t<T> >;
 
     struct state { // @suppress("Miss copy constructor or assignment operator")
         awaiter_collector _chain;
         storage_type *_cur_val = nullptr;
         std::optional<storage_type> _value_storage;
+        //waiters of select(), they receive a copy of the value
+        std::mutex _select_mx;
+        std::atomic<bool> _has_select = false;
+        _details::select_list<select_waiter<select_type> > _select;
 
         suspend_point<void> notify_awaiters() {
-            return awaiter::resume_chain(_chain);
+            suspend_point<void> ret = awaiter::resume_chain(_chain);
+            if (_has_select.load(std::memory_order_acquire)) {
+                std::lock_guard _(_select_mx);
+                while (auto w = _select.pop_front()) {
+                    if (w->claim()) {
+                        //no value when the signal is being destroyed
+                        if (_cur_val) {
+                            if constexpr(std::is_void_v<T>) {
+                                w->_value.emplace();
+                            } else {
+                                w->_value.emplace(*_cur_val);
+                            }
+                        }
+                        ret << w->notify();
+                    } else {
+                        //the waiter is released, see signal_case::disarm()
+                        std::atomic_ref<select_waiter<select_type> *>(w->_next).store(w, std::memory_order_release);
+                    }
+                }
+                _has_select.store(false, std::memory_order_relaxed);
+            }
+            return ret;
+        }
+
+        void arm_select(select_waiter<select_type> &w) {
+            std::lock_guard _(_select_mx);
+            _select.push_back(&w);
+            _has_select.store(true, std::memory_order_release);
+        }
+
+        void disarm_select(select_waiter<select_type> &w) {
+            std::lock_guard _(_select_mx);
+            _select.remove(&w);
         }
 
         ~state() {
@@ -219,6 +259,8 @@ public:
     protected:
         std::weak_ptr<state> _wk_state;
         std::coroutine_handle<> _h;
+
+        template<typename> friend class signal_case;
     };
 
     ///get signal emitter
@@ -389,6 +431,8 @@ protected:
     std::shared_ptr<state> _state;
     signal(std::shared_ptr<state> x):_state(std::move(x)) {}
 
+    template<typename> friend class signal_case;
+
 
 };
 
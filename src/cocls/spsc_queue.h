@@ -0,0 +1,212 @@
+/**
+ * @file spsc_queue.h
+ *
+ * Lock-free queue for single producer and single consumer
+ */
+#pragma once
+#ifndef SRC_cocls_SPSC_QUEUE_H_
+#define SRC_cocls_SPSC_QUEUE_H_
+
+#include "awaiter.h"
+#include "common.h"
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+
+namespace cocls {
+
+///Awaitable queue for exactly one producer and one consumer
+/**
+ * The queue is a ring buffer of fixed capacity. Push and pop are wait-free, they
+ * don't lock. Positions of the producer and the consumer are placed to separate
+ * cache lines, and each side keeps a cached copy of the position of the other side,
+ * so the cache lines are transfered only when the cached copy is exhausted.
+ *
+ * The consumer can co_await pop(). When the queue is empty, the consumer parks
+ * its awaiter in a single atomic slot. The producer takes the awaiter from the slot
+ * by one exchange and resumes it.
+ *
+ * @tparam T type of item
+ *
+ * @code
+ * spsc_queue<int> q(1024);
+ *
+ * //producer
+ * if (!q.try_push(42)) { ... queue is full ... }
+ *
+ * //consumer
+ * int v = co_await q.pop();
+ * @endcode
+ *
+ * @note only one thread (coroutine) can push and only one thread (coroutine) can pop
+ * at the same time. For multiple producers or consumers, use queue
+ */
+template<typename T>
+class spsc_queue {
+public:
+
+    ///Construct the queue
+    /**
+     * @param capacity capacity of the queue, it is rounded up to the power of two
+     */
+    explicit spsc_queue(std::size_t capacity) {
+        std::size_t cap = 1;
+        while (cap < capacity) cap <<= 1;
+        _mask = cap - 1;
+        _items = std::make_unique<slot[]>(cap);
+    }
+
+    spsc_queue(const spsc_queue &) = delete;
+    spsc_queue &operator=(const spsc_queue &) = delete;
+
+    ~spsc_queue() {
+        std::size_t t = _tail.load(std::memory_order_relaxed);
+        for (std::size_t h = _head.load(std::memory_order_relaxed); h != t; ++h) {
+            _items[h & _mask].ptr()->~T();
+        }
+    }
+
+    ///Push the item (producer side)
+    /**
+     * @param args arguments to construct the item
+     * @return suspend point which resumes the parked consumer
+     * @retval true item pushed
+     * @retval false queue is full
+     */
+    template<typename ... Args>
+    suspend_point<bool> try_push(Args && ... args) {
+        std::size_t t = _tail.load(std::memory_order_relaxed);
+        if (t - _head_cache > _mask) {
+            _head_cache = _head.load(std::memory_order_acquire);
+            if (t - _head_cache > _mask) return false;
+        }
+        new(_items[t & _mask].ptr()) T(std::forward<Args>(args)...);
+        _tail.store(t + 1, std::memory_order_release);
+        //pairs with the fence in park()
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_consumer.load(std::memory_order_relaxed)) {
+            awaiter *awt = _consumer.exchange(nullptr, std::memory_order_acquire);
+            if (awt) return {awt->resume(), true};
+        }
+        return true;
+    }
+
+    ///Pop the item if there is any (consumer side)
+    std::optional<T> try_pop() {
+        std::optional<T> out;
+        if (available()) out.emplace(take());
+        return out;
+    }
+
+    ///Awaiter of pop()
+    class pop_awaiter: public awaiter {
+    public:
+        pop_awaiter(spsc_queue &owner):_owner(owner) {}
+        pop_awaiter(const pop_awaiter &) = delete;
+        pop_awaiter &operator=(const pop_awaiter &) = delete;
+
+        bool await_ready() {
+            return _owner.available();
+        }
+        bool await_suspend(std::coroutine_handle<> h) {
+            set_handle(h);
+            return _owner.park(this);
+        }
+        T await_resume() {
+            return _owner.take();
+        }
+
+        ///wait synchronously
+        T wait() {
+            if (!await_ready()) {
+                sync_awaiter awt;
+                if (_owner.park(&awt)) awt.wait_sync();
+            }
+            return await_resume();
+        }
+
+    protected:
+        spsc_queue &_owner;
+    };
+
+    ///Pop the item (consumer side)
+    /**
+     * @return awaiter, co_await returns the item. You can also call wait()
+     */
+    pop_awaiter pop() {
+        return pop_awaiter(*this);
+    }
+
+    ///Determines whether the queue is empty (approximate when called from other thread)
+    bool empty() const {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+    ///Count of items (approximate when called from other thread)
+    std::size_t size() const {
+        std::size_t h = _head.load(std::memory_order_acquire);
+        return _tail.load(std::memory_order_acquire) - h;
+    }
+
+    ///Capacity of the queue
+    std::size_t capacity() const {
+        return _mask + 1;
+    }
+
+protected:
+
+    struct slot {
+        alignas(T) unsigned char _data[sizeof(T)];
+        T *ptr() {return std::launder(reinterpret_cast<T *>(_data));}
+    };
+
+    //consumer side
+    alignas(cache_line_size) std::atomic<std::size_t> _head = 0;
+    std::size_t _tail_cache = 0;
+    //producer side
+    alignas(cache_line_size) std::atomic<std::size_t> _tail = 0;
+    std::size_t _head_cache = 0;
+    //parked consumer, read by the producer after every push
+    alignas(cache_line_size) std::atomic<awaiter *> _consumer = nullptr;
+    //read only
+    alignas(cache_line_size) std::size_t _mask = 0;
+    std::unique_ptr<slot[]> _items;
+
+    bool available() {
+        std::size_t h = _head.load(std::memory_order_relaxed);
+        if (h != _tail_cache) return true;
+        _tail_cache = _tail.load(std::memory_order_acquire);
+        return h != _tail_cache;
+    }
+
+    T take() {
+        std::size_t h = _head.load(std::memory_order_relaxed);
+        T *p = _items[h & _mask].ptr();
+        T out(std::move(*p));
+        p->~T();
+        _head.store(h + 1, std::memory_order_release);
+        //the item was taken without available() after the consumer was woken up
+        if (_tail_cache == h) _tail_cache = h + 1;
+        return out;
+    }
+
+    //parks the consumer, returns false if an item arrived meanwhile
+    bool park(awaiter *awt) {
+        _consumer.store(awt, std::memory_order_release);
+        //pairs with the fence in try_push()
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (available()) {
+            //when the exchange fails, the producer already took the awaiter and resumes it
+            return !_consumer.compare_exchange_strong(awt, nullptr, std::memory_order_acquire);
+        }
+        return true;
+    }
+};
+
+}
+
+#endif /* SRC_cocls_SPSC_QUEUE_H_ */
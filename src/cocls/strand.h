@@ -0,0 +1,190 @@
+/**
+ * @file strand.h
+ *
+ * Strand - serial executor on top of the thread pool
+ */
+#pragma once
+#ifndef SRC_cocls_STRAND_H_
+#define SRC_cocls_STRAND_H_
+
+#include "awaiter.h"
+#include "coro_queue.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <coroutine>
+#include <thread>
+#include <utility>
+
+namespace cocls {
+
+///Strand serializes coroutines without locking
+/**
+ * The coroutine enters the strand by co_await. Coroutines in the strand are
+ * executed one by one in order of arrival (FIFO) on any free thread of the
+ * thread pool, so at most one coroutine runs in the strand at a time. The
+ * coroutine leaves the strand by next suspension (co_await on anything).
+ * To continue in the strand after an other co_await, the coroutine must co_await
+ * the strand again.
+ *
+ * @code
+ * async<void> on_message(strand &s, connection_state &st, message msg) {
+ *      co_await s;
+ *      //only one coroutine accesses st now
+ *      st.process(msg);
+ * }
+ * @endcode
+ *
+ * Waiting coroutines are stored in lock-free intrusive list of awaiters, which
+ * are allocated in the frames of the coroutines, so entering the strand doesn't
+ * allocate memory.
+ *
+ * @note strand must not be destroyed while there are coroutines in it. The destructor
+ * waits until the task, which processed the last coroutine, leaves the strand
+ */
+class strand {
+public:
+
+    ///maximum count of coroutines processed by single task in the thread pool
+    /** When there are more coroutines, the rest is processed by a new task, so
+     * the strand doesn't monopolize the thread */
+    static constexpr unsigned int batch_limit = 64;
+
+    ///Construct the strand
+    /**
+     * @param pool thread pool which runs coroutines of the strand
+     */
+    explicit strand(thread_pool &pool):_pool(pool) {}
+
+    ~strand() {
+        //the last coroutine could finish before the task left run()
+        while (_runs.load(std::memory_order_acquire)) std::this_thread::yield();
+    }
+
+    strand(const strand &) = delete;
+    strand &operator=(const strand &) = delete;
+
+    class co_awaiter: public awaiter {
+    public:
+        co_awaiter(strand &owner):_owner(owner) {}
+        co_awaiter(const co_awaiter &other):awaiter(),_owner(other._owner) {}
+        co_awaiter &operator=(const co_awaiter &) = delete;
+
+        static constexpr bool await_ready() noexcept {return false;}
+
+        void await_suspend(std::coroutine_handle<> h) {
+            set_handle(h);
+            _owner.post(this);
+        }
+
+        static constexpr void await_resume() noexcept {}
+
+    protected:
+        strand &_owner;
+    };
+
+    ///Enter the strand
+    co_awaiter operator co_await() {
+        return co_awaiter(*this);
+    }
+
+    ///Post an awaiter to the strand
+    /**
+     * @param awt awaiter, it is resumed in the strand. The awaiter must not be
+     * subscribed elsewhere
+     */
+    void post(awaiter *awt) {
+        awt->_next = _head.load(std::memory_order_relaxed);
+        while (!_head.compare_exchange_weak(awt->_next, awt, std::memory_order_release, std::memory_order_relaxed));
+        //strand was idle, schedule it
+        if (awt->_next == nullptr) schedule();
+    }
+
+    ///Determines, whether current thread runs a coroutine of this strand
+    bool is_current() const {
+        return _current == this;
+    }
+
+protected:
+
+    thread_pool &_pool;
+    //incoming requests (LIFO). nullptr - idle, doorman - running
+    awaiter_collector _head = nullptr;
+    //requests taken from _head in FIFO order, accessed only by running strand
+    awaiter *_fifo = nullptr;
+    //count of scheduled or running tasks
+    std::atomic<unsigned int> _runs = 0;
+    static thread_local const strand *_current;
+
+    static constexpr awaiter *doorman() {
+        return &awaiter::instance;
+    }
+
+    //counts the task in _runs until the task is finished or dropped by stopped pool
+    class run_guard {
+    public:
+        run_guard(strand *owner):_owner(owner) {
+            _owner->_runs.fetch_add(1, std::memory_order_relaxed);
+        }
+        run_guard(run_guard &&other):_owner(std::exchange(other._owner, nullptr)) {}
+        run_guard &operator=(const run_guard &) = delete;
+        ~run_guard() {
+            //the strand can be destroyed from now
+            if (_owner) _owner->_runs.fetch_sub(1, std::memory_order_release);
+        }
+        strand *get() const {return _owner;}
+    protected:
+        strand *_owner;
+    };
+
+    void schedule() {
+        _pool.run_detached([g = run_guard(this)]{g.get()->run();});
+    }
+
+    //moves incoming requests to FIFO
+    void take_incoming() {
+        awaiter *req = _head.exchange(doorman(), std::memory_order_acquire);
+        awaiter *tail = nullptr;
+        while (req && req != doorman()) {
+            awaiter *x = req;
+            req = req->_next;
+            x->_next = tail;
+            tail = x;
+        }
+        _fifo = tail;
+    }
+
+    void run() {
+        auto prev = std::exchange(_current, this);
+        for (unsigned int cnt = 0; cnt < batch_limit; ++cnt) {
+            if (!_fifo) {
+                take_incoming();
+                if (!_fifo) {
+                    //try to switch to idle
+                    awaiter *x = doorman();
+                    if (_head.compare_exchange_strong(x, nullptr, std::memory_order_release)) {
+                        _current = prev;
+                        return;
+                    }
+                    take_incoming();
+                }
+            }
+            awaiter *awt = _fifo;
+            _fifo = awt->_next;
+            awt->_next = nullptr;
+            //coroutine runs until it is suspended, also coroutines resumed by it are processed
+            coro_queue::install_queue_and_call([&]{
+                awt->resume();
+            });
+        }
+        _current = prev;
+        //batch limit reached, continue in new task
+        schedule();
+    }
+};
+
+inline thread_local const strand *strand::_current = nullptr;
+
+}
+
+#endif /* SRC_cocls_STRAND_H_ */
@@ -31,6 +31,8 @@ namespace cocls {
  *
  *
  * Instance of suspend_point doesn't allocate a memory until count of ready coroutines cross threshold 3.
+ * Larger lists are stored in spill buffers, which are recycled through a small thread local
+ * arena, so repeated broadcasts don't allocate in steady state.
  */
 template<typename RetVal>
 class suspend_point;
@@ -62,19 +64,43 @@ public:
     }
 
     ///merge coroutines from one suspend point to other (current)
+    /**
+     * If the source is heap backed, its buffer is spliced instead of copied. When
+     * the current suspend point is empty, the operation is O(1). Otherwise handles
+     * of the smaller one are appended to the larger buffer.
+     */
     suspend_point &operator<<(suspend_point &&other)  {
-        auto count = other._count_flag >> 1;
+        unsigned int count = other._count_flag >> 1;
         if (other._count_flag & 1) [[unlikely]] {
-            for (std::size_t i = 0; i < count; i++) {
-                add(other._ext._handles[i]);
+            ExtData src = other._ext;
+            other._count_flag = 0;
+            if ((_count_flag & 1) && _ext._capacity >= src._capacity) {
+                //our buffer is larger, append source and recycle its buffer
+                for (std::size_t i = 0; i < count; i++) {
+                    add(src._handles[i]);
+                }
+                release_buffer(src);
+            } else {
+                //adopt source buffer and move our handles into it
+                bool was_ext = (_count_flag & 1) != 0;
+                unsigned int my_count = _count_flag >> 1;
+                InlineData loc = {};
+                ExtData old = {};
+                if (was_ext) old = _ext; else loc = _local;
+                _ext = src;
+                _count_flag = (count << 1) | 1;
+                const Ptr *from = was_ext?old._handles:loc._handles;
+                for (std::size_t i = 0; i < my_count; i++) {
+                    add(from[i]);
+                }
+                if (was_ext) release_buffer(old);
             }
-            delete [] other._ext._handles;
         } else {
             for (std::size_t i = 0; i < count; i++) {
                 add(other._local._handles[i]);
             }
+            other._count_flag = 0;
         }
-        other._count_flag = 0;
         return *this;
     }
 
@@ -214,10 +240,73 @@ protected:
     //contains count+flag, flag is at BIT 0, count starts at BIT 1. You need to shift >> 1 to retrieve count
     unsigned int _count_flag = 0;
 
+    //thread local cache of spill buffers
+    /*Buffers are released to the arena of the thread, which releases the suspend point,
+     * so they can migrate between threads. Arena keeps only few largest buffers,
+     * others are deleted
+     */
+    struct spill_arena {
+        static constexpr unsigned int max_buffers = 4;
+        ExtData _buffers[max_buffers];
+        unsigned int _count = 0;
+
+        spill_arena() = default;
+        spill_arena(const spill_arena &) = delete;
+        spill_arena &operator=(const spill_arena &) = delete;
+        ~spill_arena() {
+            _destroyed = true;
+            for (unsigned int i = 0; i < _count; i++) delete [] _buffers[i]._handles;
+            _count = 0;
+        }
+
+        ExtData acquire(std::size_t capacity) {
+            for (unsigned int i = 0; i < _count; i++) {
+                if (_buffers[i]._capacity >= capacity) {
+                    ExtData r = _buffers[i];
+                    _buffers[i] = _buffers[--_count];
+                    return r;
+                }
+            }
+            return {new Ptr[capacity], capacity};
+        }
+
+        void release(ExtData buff) {
+            if (_count < max_buffers) {
+                _buffers[_count++] = buff;
+                return;
+            }
+            //arena is full, keep larger buffers
+            auto iter = std::min_element(std::begin(_buffers), std::end(_buffers), [](const ExtData &a, const ExtData &b){
+                return a._capacity < b._capacity;
+            });
+            if (iter->_capacity < buff._capacity) std::swap(*iter, buff);
+            delete [] buff._handles;
+        }
+    };
+
+    //set when the arena of the current thread has been destroyed
+    static inline thread_local bool _destroyed = false;
+
+    static spill_arena &arena() {
+        static thread_local spill_arena a;
+        return a;
+    }
+
+    static ExtData acquire_buffer(std::size_t capacity) {
+        //suspend point used during destruction of thread local variables
+        if (_destroyed) return {new Ptr[capacity], capacity};
+        return arena().acquire(capacity);
+    }
+
+    static void release_buffer(ExtData buff) {
+        if (_destroyed) delete [] buff._handles;
+        else arena().release(buff);
+    }
+
     //clear internal state - it is expected, that handles has been resumed
     constexpr void clear_internal() {
         if (_count_flag & 1) [[unlikely]] {
-            delete [] _ext._handles;
+            release_buffer(_ext);
         }
         _count_flag = 0;
     }
@@ -232,14 +321,12 @@ protected:
         if (flag) [[unlikely]] {
             //check, if we reached capacity
             if (count == _ext._capacity) [[unlikely]] {
-                //perform realloc (alloc new array, copy amd dealloc old array)
-                Ptr *nh = new Ptr[count * 2];
-                std::copy(_ext._handles, _ext._handles+count, nh);
-                delete[] _ext._handles;
-                //store new array
-                _ext._handles = nh;
-                //store new capacity
-                _ext._capacity = count*2;
+                //perform realloc (acquire new array, copy and release old array)
+                ExtData nh = acquire_buffer(count * 2);
+                std::copy(_ext._handles, _ext._handles+count, nh._handles);
+                release_buffer(_ext);
+                //store new array and its capacity
+                _ext = nh;
             }
             //add new handle to poisition
             _ext._handles[count] = h;
@@ -254,13 +341,12 @@ protected:
                 _count_flag += 2;
             } else {
                 //if we reached capacity
-                //create array on heap
-                Ptr *nh = new Ptr[count * 2];
+                //acquire spill buffer
+                ExtData nh = acquire_buffer(count * 2);
                 //copy content
-                std::copy(std::begin(_local._handles), std::end(_local._handles), nh);
+                std::copy(std::begin(_local._handles), std::end(_local._handles), nh._handles);
                 //start using _ext, initialize it
-                _ext._handles = nh;
-                _ext._capacity = count*2;
+                _ext = nh;
                 //put handle to position
                 _ext._handles[count] = h;
                 //increase counter and set flag (1 * 2 + 1 = 3);
@@ -0,0 +1,335 @@
+/**
+ * @file task_group.h
+ *
+ * Structured concurrency - group of child coroutines
+ *
+ * The task_group runs child coroutines with limited parallelism. Children
+ * are started in the current thread (coro_queue) or in a thread pool. The group
+ * can be co_awaited, which waits for completion of all children. The first
+ * exception thrown by a child is stored, remaining children are canceled
+ * and the exception is rethrown from the co_await.
+ */
+#pragma once
+#ifndef SRC_cocls_TASK_GROUP_H_
+#define SRC_cocls_TASK_GROUP_H_
+
+#include "async.h"
+#include "future.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <vector>
+
+namespace cocls {
+
+///Memory arena of a task_group
+/**
+ * The arena satisfies the Storage concept, so it can be used with with_allocator
+ * to allocate frames of child coroutines. Memory is allocated from large chunks
+ * and it is released at once, when the arena is destroyed. The destructor waits
+ * until all blocks allocated from the arena are released (for example frames of
+ * coroutines which are finishing in other threads)
+ *
+ * @code
+ * with_allocator<task_group_arena, async<void> > child(task_group_arena &, int arg);
+ *
+ * task_group grp;
+ * grp.spawn(child(grp.get_arena(), 42));
+ * @endcode
+ */
+class task_group_arena {
+public:
+
+    static constexpr std::size_t chunk_size = 16384;
+
+    task_group_arena() = default;
+    task_group_arena(const task_group_arena &) = delete;
+    task_group_arena &operator=(const task_group_arena &) = delete;
+
+    ~task_group_arena() {
+        {
+            //last block is released under the lock, so the releasing thread
+            //doesn't touch the arena after the wait returns
+            std::unique_lock lk(_mx);
+            _cond.wait(lk, [&]{return _live.load(std::memory_order_acquire) == 0;});
+        }
+        for (char *c: _chunks) delete [] c;
+    }
+
+    ///allocate a block
+    void *alloc(std::size_t sz) {
+        std::size_t need = header_size + ((sz + alignment - 1) & ~(alignment - 1));
+        char *ptr;
+        {
+            std::lock_guard _(_mx);
+            if (need > _remain) {
+                std::size_t csz = std::max(need, chunk_size);
+                _chunks.push_back(new char[csz]);
+                _pos = _chunks.back();
+                _remain = csz;
+            }
+            ptr = _pos;
+            _pos += need;
+            _remain -= need;
+        }
+        _live.fetch_add(1, std::memory_order_relaxed);
+        *reinterpret_cast<task_group_arena **>(ptr) = this;
+        return ptr + header_size;
+    }
+
+    ///release a block - memory is not reused, only count of live blocks is updated
+    static void dealloc(void *ptr, std::size_t) {
+        task_group_arena *a = *reinterpret_cast<task_group_arena **>(static_cast<char *>(ptr) - header_size);
+        auto n = a->_live.load(std::memory_order_relaxed);
+        while (n > 1) {
+            if (a->_live.compare_exchange_weak(n, n - 1, std::memory_order_release, std::memory_order_relaxed)) return;
+        }
+        std::lock_guard _(a->_mx);
+        if (a->_live.fetch_sub(1, std::memory_order_release) == 1) a->_cond.notify_all();
+    }
+
+    ///retrieve count of allocated chunks
+    std::size_t chunks() const {
+        std::lock_guard _(_mx);
+        return _chunks.size();
+    }
+
+protected:
+    static constexpr std::size_t alignment = alignof(std::max_align_t);
+    static constexpr std::size_t header_size = alignment;
+
+    mutable std::mutex _mx;
+    std::condition_variable _cond;
+    std::vector<char *> _chunks;
+    char *_pos = nullptr;
+    std::size_t _remain = 0;
+    std::atomic<std::size_t> _live = 0;
+};
+
+///Group of child coroutines
+/**
+ * Children are added by the function spawn(). There can be up to the limit of
+ * children running at the same time, other children are waiting to be started. Once a
+ * child finishes, next waiting child is started.
+ *
+ * The group is awaitable, the co_await finishes, when all children (running and
+ * waiting) are finished. If any child threw an exception, the first exception is
+ * rethrown. In that case, the group is canceled - the waiting children are never
+ * started and the running children can detect cancellation through the stop_token
+ * returned by get_token().
+ *
+ * Frames of children can be allocated from the arena of the group (see get_arena()),
+ * the arena is released at once, when the group is destroyed.
+ *
+ * @note the group should be co_awaited before it is destroyed. The destructor cancels
+ * the group and blocks until running children finish.
+ */
+class task_group {
+public:
+
+    ///no limit of running children
+    static constexpr std::size_t unlimited = std::numeric_limits<std::size_t>::max();
+
+    ///Construct group, children are started in the current thread
+    /**
+     * @param limit maximum count of running children
+     */
+    explicit task_group(std::size_t limit = unlimited):_limit(limit?limit:1) {}
+
+    ///Construct group, children are started in the thread pool
+    /**
+     * @param pool thread pool
+     * @param limit maximum count of running children
+     */
+    explicit task_group(thread_pool &pool, std::size_t limit = unlimited)
+        :_pool(&pool),_limit(limit?limit:1) {}
+
+    task_group(const task_group &) = delete;
+    task_group &operator=(const task_group &) = delete;
+
+    ~task_group() {
+        cancel();
+        co_awaiter<task_group>(*this).force_sync();
+    }
+
+    ///Add a child
+    /**
+     * @param child child coroutine. If the group is below its limit, the child is
+     * started now, otherwise it is started later. If the group is canceled, the child
+     * is destroyed without starting.
+     *
+     * @note when called in a coroutine, the child is started once the current coroutine
+     * is suspended (or in the thread pool)
+     */
+    void spawn(async<void> &&child) {
+        {
+            std::lock_guard _(_mx);
+            if (_stop.stop_requested()) return;
+            if (_running >= _limit) {
+                _pending.push_back(std::move(child));
+                return;
+            }
+            ++_running;
+        }
+        start(child);
+    }
+
+    ///Cancel the group
+    /**
+     * Waiting children are destroyed without starting and stop is requested on
+     * the stop_token. Running children are not interrupted, they need to check
+     * the token.
+     */
+    void cancel() {
+        std::deque<async<void> > drop;
+        {
+            std::lock_guard _(_mx);
+            _stop.request_stop();
+            std::swap(drop, _pending);
+        }
+        //waiting children are destroyed here, outside of the lock
+    }
+
+    ///Retrieve stop token of the group, children can use it to detect cancellation
+    std::stop_token get_token() const {return _stop.get_token();}
+
+    ///Retrieve arena, which can be used to allocate frames of children
+    task_group_arena &get_arena() {return _arena;}
+
+    ///Count of running children
+    std::size_t running() const {
+        std::lock_guard _(_mx);
+        return _running;
+    }
+
+    ///Count of children waiting to be started
+    std::size_t pending() const {
+        std::lock_guard _(_mx);
+        return _pending.size();
+    }
+
+    ///Wait for all children
+    /**
+     * @return awaitable object. The co_await throws the first exception thrown by a child
+     */
+    co_awaiter<task_group> operator co_await() {return *this;}
+
+    ///Wait for all children
+    /**
+     * @return awaitable object. The co_await throws the first exception thrown by a child
+     */
+    co_awaiter<task_group> join() {return *this;}
+
+protected:
+
+    friend class ::cocls::co_awaiter<task_group>;
+
+    ///future, which receives result of a child. It is allocated in the arena
+    class child_future: public future<void>, public awaiter {
+    public:
+        child_future(task_group &owner):_owner(owner) {
+            this->_awaiter = this;
+            set_resume_fn(&on_finish);
+        }
+
+        promise<void> get_promise() {
+            return promise<void>(*this);
+        }
+
+        static suspend_point<void> on_finish(awaiter *me, void *) noexcept {
+            auto _this = static_cast<child_future *>(me);
+            std::exception_ptr e;
+            try {
+                _this->value();
+            } catch (...) {
+                e = std::current_exception();
+            }
+            task_group &owner = _this->_owner;
+            _this->~child_future();
+            task_group_arena::dealloc(_this, sizeof(child_future));
+            return owner.child_finished(std::move(e));
+        }
+
+    protected:
+        task_group &_owner;
+    };
+
+    mutable std::mutex _mx;
+    thread_pool *_pool = nullptr;
+    std::size_t _limit;
+    std::size_t _running = 0;
+    std::deque<async<void> > _pending;
+    std::exception_ptr _exception;
+    std::stop_source _stop;
+    awaiter *_waiting = nullptr;
+    task_group_arena _arena;
+
+    suspend_point<void> start(async<void> &child) {
+        auto f = new(_arena.alloc(sizeof(child_future))) child_future(*this);
+        suspend_point<bool> sp = child.start(f->get_promise());
+        if (_pool) {
+            _pool->resume(sp);
+            return {};
+        }
+        return sp;
+    }
+
+    suspend_point<void> child_finished(std::exception_ptr e) {
+        std::deque<async<void> > drop;
+        std::optional<async<void> > next;
+        awaiter *waiting = nullptr;
+        {
+            std::lock_guard _(_mx);
+            if (e && !_exception) {
+                _exception = std::move(e);
+                _stop.request_stop();
+                std::swap(drop, _pending);
+            }
+            if (!_pending.empty()) {
+                next.emplace(std::move(_pending.front()));
+                _pending.pop_front();
+            } else {
+                --_running;
+                if (_running == 0) waiting = std::exchange(_waiting, nullptr);
+            }
+        }
+        drop.clear();
+        suspend_point<void> ret;
+        //the group can be destroyed once the waiting awaiters are resumed, don't touch it
+        if (next) ret << start(*next);
+        ret << awaiter::resume_chain_lk(waiting);
+        return ret;
+    }
+
+    bool ready() const {
+        std::lock_guard _(_mx);
+        return _running == 0;
+    }
+
+    bool subscribe(awaiter *awt) {
+        std::lock_guard _(_mx);
+        if (_running == 0) return false;
+        awt->_next = _waiting;
+        _waiting = awt;
+        return true;
+    }
+
+    void value() {
+        std::lock_guard _(_mx);
+        if (_exception) std::rethrow_exception(_exception);
+    }
+};
+
+
+}
+
+#endif /* SRC_cocls_TASK_GROUP_H_ */
@@ -11,8 +11,15 @@
 #include "generics.h"
 #include "async.h"
 #include "function.h"
+#include "instrumentation.h"
+#include "tracing.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <thread>
@@ -30,12 +37,48 @@ public:
 
     using q_item = function<void()>;
 
+    ///Priority of a task. Every priority has own queue (lane)
+    enum class priority: unsigned int {
+        ///latency critical tasks
+        critical,
+        ///high priority tasks
+        high,
+        ///default priority
+        normal,
+        ///bulk background work
+        background
+    };
+
+    ///count of priority levels
+    static constexpr unsigned int priority_levels = 4;
+
+    ///How workers choose between lanes
+    enum class dispatch_mode {
+        ///always take the task from the highest non-empty lane
+        strict,
+        ///lanes are served in proportion of their weights
+        weighted
+    };
+
+    ///Configuration of dispatching between lanes
+    struct dispatch_config {
+        ///dispatch mode
+        dispatch_mode mode = dispatch_mode::strict;
+        ///weights of lanes (weighted mode), index is priority
+        unsigned int weights[priority_levels] = {8, 4, 2, 1};
+        ///anti-starvation aging. The task which waits while this count of other tasks
+        ///has been dispatched is taken regardless on its priority. Zero disables aging
+        std::uint64_t aging = 256;
+    };
+
     ///Start thread pool
     /**
      * @param threads count of threads. Default value creates same amount as count
      * of available CPU cores (hardware_concurrency)
+     * @param policy defines how long idle workers spin before they are parked
      */
-    thread_pool(unsigned int threads = 0)
+    thread_pool(unsigned int threads = 0, idle_policy policy = {})
+        :_policy(policy)
     {
         if (!threads) threads = std::thread::hardware_concurrency();
         for (unsigned int i = 0; i < threads; i++) {
@@ -44,6 +87,51 @@ public:
     }
 
 
+    ///Configuration of an elastic thread pool
+    struct elastic_config {
+        ///minimum count of threads (started at construction)
+        unsigned int min_threads = 1;
+        ///maximum count of threads
+        unsigned int max_threads = std::thread::hardware_concurrency() * 4;
+        ///new thread is started, when no task has been dequeued for this time and there is no idle worker
+        std::chrono::steady_clock::duration spawn_latency = std::chrono::milliseconds(1);
+        ///thread above minimum is retired, when it is idle for this time
+        std::chrono::steady_clock::duration idle_timeout = std::chrono::seconds(10);
+    };
+
+    ///Statistics of an elastic thread pool
+    struct elastic_stats {
+        ///current count of threads
+        unsigned int threads;
+        ///highest count of threads
+        unsigned int peak_threads;
+        ///count of threads started above minimum
+        unsigned int spawned;
+        ///count of retired threads
+        unsigned int retired;
+    };
+
+    ///Start elastic thread pool
+    /**
+     * The pool starts with min_threads. A supervisor thread watches the queue. When
+     * the queue is not empty, no worker is idle and no task has been dequeued for the
+     * spawn_latency (for example all workers are blocked in long calls), a new thread is
+     * started, up to max_threads. Threads above min_threads are retired, when they are
+     * idle longer than idle_timeout.
+     *
+     * @param cfg configuration
+     * @param policy defines how long idle workers spin before they are parked
+     */
+    explicit thread_pool(const elastic_config &cfg, idle_policy policy = {})
+        :_policy(policy)
+        ,_elastic(std::make_unique<elastic_state>(cfg))
+    {
+        std::lock_guard _(_mx);
+        for (unsigned int i = 0; i < std::max(cfg.min_threads, 1U); i++) spawn_lk();
+        _elastic->_stats.spawned = 0;
+        _elastic->_monitor = std::thread([this]{monitor();});
+    }
+
     ///Start a worker
     /**
      * By default, workers are started during construction. This function allows
@@ -53,10 +141,32 @@ public:
         _current = this;
         std::unique_lock lk(_mx);
         for(;;) {
-            _cond.wait(lk, [&]{return !_queue.empty() || _exit;});
+            if (empty_lk() && !_exit) {
+                //spin outside of the lock, until a task appears
+                lk.unlock();
+                spin_until(_policy.load(std::memory_order_relaxed), [&]{
+                    return _queued.load(std::memory_order_relaxed) != 0;
+                });
+                lk.lock();
+                if (empty_lk() && !_exit) {
+                    //parked workers are counted, so enqueue notifies only if needed
+                    _sleepers.fetch_add(1, std::memory_order_relaxed);
+                    if (_elastic) {
+                        bool ok = _cond.wait_for(lk, _elastic->_cfg.idle_timeout, [&]{return !empty_lk() || _exit;});
+                        _sleepers.fetch_sub(1, std::memory_order_relaxed);
+                        if (!ok) {
+                            if (retire_lk()) return;
+                            continue;
+                        }
+                    } else {
+                        _cond.wait(lk, [&]{return !empty_lk() || _exit;});
+                        _sleepers.fetch_sub(1, std::memory_order_relaxed);
+                    }
+                }
+            }
             if (_exit) break;
-            auto h = std::move(_queue.front());
-            _queue.pop();
+            auto h = pop_lk();
+            if (_elastic) _elastic->_progress = std::chrono::steady_clock::now();
             lk.unlock();
             h();
             //if _current is nullptr, thread_pool has been destroyed
@@ -71,14 +181,23 @@ public:
      */
     void stop() {
         decltype(_threads) tmp;
-        decltype(_queue) q;
+        decltype(_lanes) q;
+        std::thread monitor;
         {
             std::unique_lock lk(_mx);
             _exit = true;
             _cond.notify_all();
             std::swap(tmp, _threads);
-            std::swap(q, _queue);
+            if (_elastic) {
+                _elastic->_monitor_cond.notify_all();
+                std::swap(monitor, _elastic->_monitor);
+                for (std::thread &t: _elastic->_retired) tmp.push_back(std::move(t));
+                _elastic->_retired.clear();
+            }
+            std::swap(q, _lanes);
+            _queued.store(0, std::memory_order_relaxed);
         }
+        if (monitor.joinable()) monitor.join();
         auto me = std::this_thread::get_id();
         for (std::thread &t: tmp) {
             if (t.get_id() == me) {
@@ -104,7 +223,7 @@ public:
     class co_awaiter {
     public:
         co_awaiter() = default;
-        co_awaiter(thread_pool &owner):_owner(&owner) {}
+        co_awaiter(thread_pool &owner, priority prio = priority::normal):_owner(&owner),_prio(prio) {}
         co_awaiter(const co_awaiter&) = default;
         co_awaiter &operator=(const co_awaiter&) = delete;
 
@@ -123,7 +242,7 @@ public:
 
             //enqueue function
             //awtptr contains pointer to our awaiter
-           _owner->enqueue([awtptr = std::unique_ptr<co_awaiter, decltype(fin)>(this,fin)]() mutable {
+           _owner->enqueue(_prio, [awtptr = std::unique_ptr<co_awaiter, decltype(fin)>(this,fin)]() mutable {
                //when function is called
                //retrieve handle
                auto h = awtptr->_h;
@@ -145,9 +264,20 @@ public:
 
     protected:
         thread_pool *_owner = nullptr;
+        priority _prio = priority::normal;
         std::coroutine_handle<> _h;
     };
 
+    ///Awaitable object, which transfers coroutine to the thread pool with a priority
+    class priority_transfer {
+    public:
+        priority_transfer(thread_pool &owner, priority prio):_owner(owner),_prio(prio) {}
+        co_awaiter operator co_await() {return co_awaiter(_owner, _prio);}
+    protected:
+        thread_pool &_owner;
+        priority _prio;
+    };
+
     template<typename Awt>
     class enqueue_awaiter: public awaiter {
     public:
@@ -202,10 +332,10 @@ public:
      * @return a value associated with suspend point.
      */
     template<typename T>
-    T resume(suspend_point<T> &spt) {
+    T resume(suspend_point<T> &spt, priority prio = priority::normal) {
         while (!spt.empty()) {
             std::coroutine_handle<> h = spt.pop();
-            enqueue([h]{coro_queue::resume(h);});
+            enqueue(prio, [h]{coro_queue::resume(h);});
         }
         if constexpr(!std::is_void_v<T>) {
             return spt;
@@ -219,8 +349,82 @@ public:
      * @return a value associated with suspend point.
      */
     template<typename T>
-    T resume(suspend_point<T> &&spt) {
-        return resume(spt);
+    T resume(suspend_point<T> &&spt, priority prio = priority::normal) {
+        return resume(spt, prio);
+    }
+
+    ///Distribute coroutines of a suspend point across the thread pool in chunks
+    /**
+     * Resolving a future, shared_future or signal awaited by many coroutines produces
+     * suspend_point which carries all woken coroutines. By passing such suspend_point
+     * to this function, woken coroutines are split into chunks, each chunk is
+     * enqueued as single task, so the wakeup is spread over all threads of the pool.
+     * All chunks are enqueued under single lock.
+     *
+     * @code
+     * thread_pool pool;
+     * promise<config> p = ...;
+     * pool.fan_out(p(new_config));  //resume all awaiting coroutines in the pool
+     * @endcode
+     *
+     * @param spt suspend point instance
+     * @param chunk count of coroutines per one task. Default value (0) splits coroutines
+     * evenly between threads.
+     * @param prio priority of the tasks
+     * @return a value associated with suspend point.
+     *
+     * @note if the pool is stopped, coroutines are left in the suspend point, and they
+     * are resumed in the current thread
+     */
+    template<typename T>
+    T fan_out(suspend_point<T> &spt, std::size_t chunk = 0, priority prio = priority::normal) {
+        if (!spt.empty()) {
+            std::lock_guard _(_mx);
+            if (!_exit) {
+                if (!chunk) {
+                    std::size_t thr = std::max<std::size_t>(_threads.size(), 1);
+                    chunk = (spt.size() + thr - 1) / thr;
+                }
+                std::size_t tasks = 0;
+                if (_elastic && empty_lk()) _elastic->_progress = std::chrono::steady_clock::now();
+                lane &ln = _lanes[static_cast<unsigned int>(prio)];
+                while (!spt.empty()) {
+                    suspend_point<void> part;
+                    for (std::size_t i = 0; i < chunk && !spt.empty(); i++) {
+                        part << spt.pop();
+                    }
+                    ln._items.push({[part = std::move(part)]() mutable {
+                        part.clear();
+                    }, _dispatched});
+                    ln._stamps.push();
+                    ++tasks;
+                }
+                _queued.fetch_add(tasks, std::memory_order_relaxed);
+                instrumentation::record(instrumentation::histogram::thread_pool_queue_depth, _queued.load(std::memory_order_relaxed));
+                auto sleepers = _sleepers.load(std::memory_order_relaxed);
+                if (sleepers) {
+                    if (tasks > 1) _cond.notify_all(); else _cond.notify_one();
+                }
+            }
+        }
+        if constexpr(!std::is_void_v<T>) {
+            return spt;
+        }
+    }
+
+    ///Distribute coroutines of a suspend point across the thread pool in chunks
+    /**
+     * @param spt suspend point instance
+     * @param chunk count of coroutines per one task. Default value (0) splits coroutines
+     * evenly between threads.
+     * @param prio priority of the tasks
+     * @return a value associated with suspend point.
+     *
+     * @see fan_out(suspend_point<T> &, std::size_t, priority)
+     */
+    template<typename T>
+    T fan_out(suspend_point<T> &&spt, std::size_t chunk = 0, priority prio = priority::normal) {
+        return fan_out(spt, chunk, prio);
     }
 
     ///Transfer coroutine to the thread pool
@@ -239,16 +443,32 @@ public:
         return *this;
     }
 
+    ///Transfer coroutine to the thread pool with a priority
+    /**
+     * @param prio priority
+     * @return awaitable object
+     *
+     * @code
+     * task<> handle_request(thread_pool &p) {
+     *      co_await p.with_priority(thread_pool::priority::critical);
+     * }
+     * @endcode
+     */
+    priority_transfer with_priority(priority prio) {
+        return priority_transfer(*this, prio);
+    }
+
     ///Run function in thread pool
     /**
      *
      * @param fn function to run. The function must return void. The function
      * run() returns immediately
+     * @param prio priority
      */
     template<typename Fn>
     CXX20_REQUIRES(std::same_as<void, decltype(std::declval<Fn>()())>)
-    void run_detached(Fn &&fn) {
-        enqueue(q_item(std::forward<Fn>(fn)));
+    void run_detached(Fn &&fn, priority prio = priority::normal) {
+        enqueue(prio, q_item(std::forward<Fn>(fn)));
     }
 
     ///Runs function in thread pool, returns future
@@ -256,10 +476,11 @@ public:
      * Works similar as std::async. It just runs function in thread pool and returns
      * cocls::future.
      * @param fn function to run
+     * @param prio priority
      * @return future<Ret> where Ret is return value of the function
      */
     template<typename Fn>
-    auto run(Fn &&fn) -> future<decltype(std::declval<Fn>()())> {
+    auto run(Fn &&fn, priority prio = priority::normal) -> future<decltype(std::declval<Fn>()())> {
         using RetVal = decltype(std::declval<Fn>()());
         return [&](auto promise) {
             run_detached([fn = std::tuple<Fn>(std::forward<Fn>(fn)), promise = std::move(promise)]() mutable {
@@ -273,28 +494,49 @@ public:
                 } catch(...) {
                     promise(std::current_exception());
                 }
-            });
+            }, prio);
         };
     }
 
     ///start async coroutine in the thread pool
     /**
      * @param fn asynchronous coroutine
+     * @param prio priority
      * @return future object which captures a result
      *
      * @note if you need to start async<> in thread pool without returning the future<>, you
      * can simply call run(fn.detach())
      */
-    template<typename T>
-    future<T> run(async<T> &fn) {
+    template<typename T, typename Policy>
+    future<T> run(async<T, Policy> &fn, priority prio = priority::normal) {
         return [&](auto promise) {
-            resume(fn.start(promise));
+            resume(fn.start(promise), prio);
         };
     }
 
-    template<typename T>
-    future<T> run(async<T> &&fn) {
-        return run(fn);
+    template<typename T, typename Policy>
+    future<T> run(async<T, Policy> &&fn, priority prio = priority::normal) {
+        return run(fn, prio);
+    }
+
+    ///Post an awaiter to the thread pool
+    /**
+     * @param awt awaiter, it is resumed in the thread pool. The awaiter must not be
+     * subscribed elsewhere
+     * @param prio priority
+     *
+     * @note allows to use the thread pool as executor of resumption_policy::executor
+     *
+     * @note when the thread pool is stopped, the awaiter is resumed in the current thread
+     */
+    void post(awaiter *awt, priority prio = priority::normal) {
+        //this lambda function is called when enqueued function is destroyed without calling
+        auto fin = [](awaiter *x) {
+            x->resume();
+        };
+        enqueue(prio, [awtptr = std::unique_ptr<awaiter, decltype(fin)>(awt, fin)]() mutable {
+            awtptr.release()->resume();
+        });
     }
 
     struct current {
@@ -336,7 +578,49 @@ public:
     ///returns true if there is still enqueued task
     bool any_enqueued() {
         std::unique_lock lk(_mx);
-        return _exit || !_queue.empty();
+        return _exit || !empty_lk();
+    }
+
+    ///Change dispatching between lanes
+    void set_dispatch(const dispatch_config &cfg) {
+        std::lock_guard _(_mx);
+        _dispatch = cfg;
+        for (unsigned int i = 0; i < priority_levels; i++) _lanes[i]._credit = _dispatch.weights[i];
+    }
+
+    ///Retrieve count of enqueued tasks of given priority
+    std::size_t get_enqueued(priority prio) const {
+        std::lock_guard _(_mx);
+        return _lanes[static_cast<unsigned int>(prio)]._items.size();
+    }
+
+    ///Set idle policy of workers
+    void set_idle_policy(idle_policy policy) {
+        _policy.store(policy, std::memory_order_relaxed);
+    }
+
+    ///Get idle policy of workers
+    idle_policy get_idle_policy() const {
+        return _policy.load(std::memory_order_relaxed);
+    }
+
+    ///Current count of threads
+    unsigned int get_thread_count() const {
+        std::lock_guard _(_mx);
+        return static_cast<unsigned int>(_threads.size());
+    }
+
+    ///Statistics of elastic thread pool (for fixed pool, only count of threads is filled)
+    elastic_stats get_elastic_stats() const {
+        std::lock_guard _(_mx);
+        if (_elastic) return _elastic->_stats;
+        auto n = static_cast<unsigned int>(_threads.size());
+        return {n, n, 0, 0};
+    }
+
+    ///Count of parked workers
+    unsigned int get_sleepers() const {
+        return _sleepers.load(std::memory_order_relaxed);
     }
 
     friend bool is_current(const thread_pool &pool) {
@@ -351,18 +635,165 @@ protected:
 
 
     void enqueue(q_item &&fn) {
+        enqueue(priority::normal, std::move(fn));
+    }
+
+    void enqueue(priority prio, q_item &&fn) {
+        tracing::trace(tracing::event::enqueue, nullptr, this);
         std::lock_guard _(_mx);
         if (!_exit) {
-            _queue.push(std::move(fn));
-            _cond.notify_one();
+            if (_elastic && empty_lk()) _elastic->_progress = std::chrono::steady_clock::now();
+            lane &ln = _lanes[static_cast<unsigned int>(prio)];
+            ln._items.push({std::move(fn), _dispatched});
+            ln._stamps.push();
+            auto depth = _queued.fetch_add(1, std::memory_order_relaxed) + 1;
+            instrumentation::record(instrumentation::histogram::thread_pool_queue_depth, depth);
+            //sleepers are changed under the lock, so no parked worker can be missed
+            if (_sleepers.load(std::memory_order_relaxed)) _cond.notify_one();
         }
     }
 
 
-    mutable std::mutex _mx;
+    struct elastic_state {
+        elastic_config _cfg;
+        elastic_stats _stats = {};
+        //time of last dequeue or of enqueue to empty queue
+        std::chrono::steady_clock::time_point _progress = std::chrono::steady_clock::now();
+        std::condition_variable _monitor_cond;
+        std::thread _monitor;
+        //retired threads, which need to be joined
+        std::vector<std::thread> _retired;
+
+        elastic_state(const elastic_config &cfg):_cfg(cfg) {}
+    };
+
+    void spawn_lk() {
+        _threads.push_back(std::thread([this]{worker();}));
+        elastic_stats &st = _elastic->_stats;
+        st.threads = static_cast<unsigned int>(_threads.size());
+        st.peak_threads = std::max(st.peak_threads, st.threads);
+        ++st.spawned;
+        instrumentation::record(instrumentation::histogram::thread_pool_size, st.threads);
+    }
+
+    //called by idle worker, returns true, if the worker has been retired
+    bool retire_lk() {
+        if (_exit || _threads.size() <= _elastic->_cfg.min_threads) return false;
+        auto me = std::this_thread::get_id();
+        auto iter = std::find_if(_threads.begin(), _threads.end(), [&](const std::thread &t){
+            return t.get_id() == me;
+        });
+        //thread which called worker() directly is not retired
+        if (iter == _threads.end()) return false;
+        _elastic->_retired.push_back(std::move(*iter));
+        _threads.erase(iter);
+        elastic_stats &st = _elastic->_stats;
+        st.threads = static_cast<unsigned int>(_threads.size());
+        ++st.retired;
+        instrumentation::record(instrumentation::histogram::thread_pool_size, st.threads);
+        _current = nullptr;
+        return true;
+    }
+
+    //supervisor of elastic pool
+    void monitor() {
+        auto period = std::max<std::chrono::steady_clock::duration>(
+                _elastic->_cfg.spawn_latency / 4, std::chrono::microseconds(100));
+        std::unique_lock lk(_mx);
+        while (!_exit) {
+            _elastic->_monitor_cond.wait_for(lk, period);
+            if (_exit) break;
+            auto now = std::chrono::steady_clock::now();
+            if (!empty_lk() && _sleepers.load(std::memory_order_relaxed) == 0
+                    && now - _elastic->_progress >= _elastic->_cfg.spawn_latency
+                    && _threads.size() < _elastic->_cfg.max_threads) {
+                spawn_lk();
+                //give the new thread a chance before next one is started
+                _elastic->_progress = now;
+            }
+            if (!_elastic->_retired.empty()) {
+                auto r = std::move(_elastic->_retired);
+                _elastic->_retired.clear();
+                lk.unlock();
+                for (std::thread &t: r) t.join();
+                lk.lock();
+            }
+        }
+    }
+
+    struct lane_item {
+        q_item _fn;
+        //value of _dispatched when the item has been enqueued (for aging)
+        std::uint64_t _seq;
+    };
+
+    struct lane {
+        std::queue<lane_item> _items;
+        [[no_unique_address]] instrumentation::stamp_queue _stamps;
+        unsigned int _credit = 0;
+    };
+
+    bool empty_lk() const {
+        return _queued.load(std::memory_order_relaxed) == 0;
+    }
+
+    //choose lane and pick a task, queue must not be empty
+    q_item pop_lk() {
+        lane *sel = nullptr;
+        //aging - the oldest task which waits too long is taken first, on tie
+        //the lowest priority wins, as higher priorities are served anyway
+        if (_dispatch.aging) {
+            std::uint64_t oldest = _dispatched;
+            for (lane &ln: _lanes) {
+                if (!ln._items.empty() && _dispatched - ln._items.front()._seq >= _dispatch.aging
+                        && ln._items.front()._seq <= oldest) {
+                    oldest = ln._items.front()._seq;
+                    sel = &ln;
+                }
+            }
+        }
+        if (!sel) {
+            if (_dispatch.mode == dispatch_mode::strict) {
+                for (lane &ln: _lanes) {
+                    if (!ln._items.empty()) {sel = &ln; break;}
+                }
+            } else {
+                //weighted: highest lane with remaining credit, credits are refilled
+                //when all non-empty lanes spent their credits
+                for (int pass = 0; !sel && pass < 2; ++pass) {
+                    for (lane &ln: _lanes) {
+                        if (!ln._items.empty() && ln._credit) {sel = &ln; break;}
+                    }
+                    if (!sel) {
+                        for (unsigned int i = 0; i < priority_levels; i++) {
+                            _lanes[i]._credit = std::max(_dispatch.weights[i], 1U);
+                        }
+                    }
+                }
+                --sel->_credit;
+            }
+        }
+        q_item fn = std::move(sel->_items.front()._fn);
+        sel->_items.pop();
+        sel->_stamps.pop(instrumentation::histogram::thread_pool_dispatch_latency);
+        _queued.fetch_sub(1, std::memory_order_relaxed);
+        ++_dispatched;
+        return fn;
+    }
+
+    COCLS_CONTENDED mutable std::mutex _mx;
     std::condition_variable _cond;
-    std::queue<q_item> _queue;
+    std::array<lane, priority_levels> _lanes;
+    dispatch_config _dispatch;
+    //count of dispatched tasks
+    std::uint64_t _dispatched = 0;
     std::vector<std::thread> _threads;
+    //count of tasks in the queue, spinning workers read it without the lock
+    COCLS_CONTENDED std::atomic<std::size_t> _queued = 0;
+    //count of parked workers, changed under the lock
+    COCLS_CONTENDED std::atomic<unsigned int> _sleepers = 0;
+    COCLS_CONTENDED std::atomic<idle_policy> _policy;
+    std::unique_ptr<elastic_state> _elastic;
     bool _exit = false;
     static thread_local thread_pool *_current;
 
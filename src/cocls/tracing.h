@@ -0,0 +1,257 @@
+/**
+ * @file tracing.h
+ *
+ * Optional tracing of coroutine events
+ *
+ * Tracing is enabled by defining the macro COCLS_TRACING before any header of the
+ * library is included. Every thread records events into own ring buffer, older
+ * events are overwritten. The content of all rings can be exported in Chrome
+ * trace format (JSON), which can be opened in chrome://tracing or in Perfetto UI.
+ *
+ * Size of the ring (count of events per thread) can be changed by the macro
+ * COCLS_TRACING_RING_SIZE (must be power of two)
+ */
+#pragma once
+#ifndef SRC_cocls_TRACING_H_
+#define SRC_cocls_TRACING_H_
+
+#include "common.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#ifndef COCLS_TRACING_RING_SIZE
+#define COCLS_TRACING_RING_SIZE 4096
+#endif
+
+namespace cocls {
+
+namespace tracing {
+
+#ifdef COCLS_TRACING
+///true if the tracing is enabled
+constexpr bool enabled = true;
+#else
+///true if the tracing is enabled
+constexpr bool enabled = false;
+#endif
+
+///Type of event
+enum class event: std::uint32_t {
+    ///awaiter has been resumed (coroutine or callback)
+    resume,
+    ///coroutine has been suspended on an awaitable object
+    suspend,
+    ///coroutine has been placed to coro_queue
+    queue,
+    ///task has been enqueued to thread pool
+    enqueue,
+    ///coroutine has finished
+    finish
+};
+
+///Returns name of the event
+inline const char *name(event e) {
+    static const char *names[] = {"resume", "suspend", "queue", "enqueue", "finish"};
+    return names[static_cast<unsigned int>(e)];
+}
+
+///Recorded event
+struct record {
+    ///time in nanoseconds (steady clock)
+    std::uint64_t timestamp;
+    ///coroutine (can be nullptr)
+    coro_id coro;
+    ///related object (awaiter, awaited object, thread pool, future)
+    const void *object;
+    ///type of event
+    event type;
+};
+
+///Events of single thread
+struct thread_trace {
+    ///index of the thread (in order of first event)
+    unsigned int thread;
+    ///events ordered by time
+    std::vector<record> events;
+};
+
+namespace _details {
+
+///Ring buffer of events
+/**
+ * Only owning thread writes. Fields are relaxed atomics, so other thread can
+ * read the ring while it is being written. Reader discards events, which could be
+ * overwritten during reading.
+ */
+class trace_ring {
+public:
+    static constexpr std::size_t size = COCLS_TRACING_RING_SIZE;
+    static_assert((size & (size - 1)) == 0, "COCLS_TRACING_RING_SIZE must be power of two");
+
+    trace_ring(unsigned int thread):_thread(thread) {}
+
+    void push(event e, coro_id coro, const void *object) {
+        std::uint64_t h = _head.load(std::memory_order_relaxed);
+        slot &s = _slots[h & (size - 1)];
+        s._ts.store(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count()), std::memory_order_relaxed);
+        s._coro.store(coro, std::memory_order_relaxed);
+        s._object.store(object, std::memory_order_relaxed);
+        s._type.store(e, std::memory_order_relaxed);
+        _head.store(h + 1, std::memory_order_release);
+    }
+
+    thread_trace read() const {
+        thread_trace out{_thread, {}};
+        std::uint64_t h = _head.load(std::memory_order_acquire);
+        std::uint64_t from = h > size?h - size:0;
+        out.events.reserve(static_cast<std::size_t>(h - from));
+        for (std::uint64_t i = from; i < h; i++) {
+            const slot &s = _slots[i & (size - 1)];
+            out.events.push_back({
+                s._ts.load(std::memory_order_relaxed),
+                s._coro.load(std::memory_order_relaxed),
+                s._object.load(std::memory_order_relaxed),
+                s._type.load(std::memory_order_relaxed)
+            });
+        }
+        //events, which were overwritten during reading, are removed
+        std::atomic_thread_fence(std::memory_order_acquire);
+        std::uint64_t h2 = _head.load(std::memory_order_relaxed);
+        if (h2 > size && h2 - size > from) {
+            std::size_t lost = static_cast<std::size_t>(std::min(h2 - size, h) - from);
+            out.events.erase(out.events.begin(), out.events.begin() + lost);
+        }
+        return out;
+    }
+
+protected:
+    struct slot {
+        std::atomic<std::uint64_t> _ts = 0;
+        std::atomic<coro_id> _coro = nullptr;
+        std::atomic<const void *> _object = nullptr;
+        std::atomic<event> _type = event::resume;
+    };
+
+    unsigned int _thread;
+    std::atomic<std::uint64_t> _head = 0;
+    slot _slots[size];
+};
+
+///Registry of rings of all threads
+class trace_registry {
+public:
+    ///count of rings of finished threads, which are kept
+    static constexpr std::size_t max_retired = 64;
+
+    static trace_registry &get() {
+        static trace_registry r;
+        return r;
+    }
+
+    std::shared_ptr<trace_ring> create() {
+        std::lock_guard _(_mx);
+        auto r = std::make_shared<trace_ring>(_next_thread++);
+        _rings.push_back(r);
+        return r;
+    }
+
+    void retire(const std::shared_ptr<trace_ring> &r) {
+        std::lock_guard _(_mx);
+        std::erase(_rings, r);
+        _retired.push_back(r);
+        if (_retired.size() > max_retired) _retired.erase(_retired.begin());
+    }
+
+    std::vector<thread_trace> collect() {
+        std::vector<std::shared_ptr<trace_ring> > rings;
+        {
+            std::lock_guard _(_mx);
+            rings = _retired;
+            rings.insert(rings.end(), _rings.begin(), _rings.end());
+        }
+        std::vector<thread_trace> out;
+        for (const auto &r: rings) out.push_back(r->read());
+        return out;
+    }
+
+protected:
+    std::mutex _mx;
+    std::vector<std::shared_ptr<trace_ring> > _rings;
+    std::vector<std::shared_ptr<trace_ring> > _retired;
+    unsigned int _next_thread = 0;
+};
+
+struct trace_ring_holder {
+    std::shared_ptr<trace_ring> _ring = trace_registry::get().create();
+    ~trace_ring_holder() {trace_registry::get().retire(_ring);}
+};
+
+inline trace_ring &current_ring() {
+    static thread_local trace_ring_holder holder;
+    return *holder._ring;
+}
+
+}
+
+///Record an event
+/**
+ * @param e type of event
+ * @param coro coroutine
+ * @param object related object
+ */
+inline void trace([[maybe_unused]] event e, [[maybe_unused]] coro_id coro, [[maybe_unused]] const void *object) {
+    if constexpr(enabled) _details::current_ring().push(e, coro, object);
+}
+
+///Collect events of all threads
+/**
+ * Returns recent events of running threads and of few recently finished threads.
+ * When tracing is disabled, returns empty list
+ */
+inline std::vector<thread_trace> collect() {
+    if constexpr(enabled) return _details::trace_registry::get().collect();
+    else return {};
+}
+
+///Export recorded events in Chrome trace format (JSON)
+/**
+ * The output can be loaded by chrome://tracing or ui.perfetto.dev. Every event
+ * is exported as instant event of the thread, with the coroutine and the object in
+ * arguments.
+ *
+ * @param out output stream
+ */
+inline void dump_chrome_trace(std::ostream &out) {
+    auto traces = collect();
+    std::uint64_t base = ~std::uint64_t(0);
+    for (const auto &t: traces) {
+        if (!t.events.empty()) base = std::min(base, t.events.front().timestamp);
+    }
+    out << "{\"traceEvents\":[";
+    const char *sep = "\n";
+    for (const auto &t: traces) {
+        for (const record &r: t.events) {
+            std::uint64_t ts = r.timestamp - base;
+            out << sep << "{\"name\":\"" << name(r.type) << "\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1"
+                << ",\"tid\":" << t.thread
+                << ",\"ts\":" << ts / 1000 << "." << (ts % 1000) / 100 << (ts % 100) / 10 << ts % 10
+                << ",\"args\":{\"coro\":\"" << r.coro << "\",\"object\":\"" << r.object << "\"}}";
+            sep = ",\n";
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+}
+
+}
+
+#endif /* SRC_cocls_TRACING_H_ */
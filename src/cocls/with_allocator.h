@@ -4,8 +4,14 @@
 
 
 #include "common.h"
+#include <atomic>
 #include <coroutine>
 #include <concepts>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 
 namespace cocls {
@@ -38,6 +44,41 @@ private:
 
 };
 
+///promise of coroutine declared by with_allocator
+/**
+ * @tparam Params types of parameters of the coroutine (including the object
+ * of a member function). The storage is the first parameter, which is the Allocator
+ *
+ * @note operator new is not a template, because GCC reports -Wmismatched-new-delete
+ * when the frame allocated by a template operator new is released by operator delete
+ */
+template<typename Allocator, typename Base, typename ... Params> CXX20_REQUIRES(Storage<Allocator>)
+class coro_allocator_base: public Base {
+public:
+
+    using Base::Base;
+
+    void *operator new(std::size_t sz, std::remove_reference_t<Params> & ... params) {
+        return storage(params...).alloc(sz);
+    }
+
+    void operator delete(void *ptr, std::size_t sz) {
+        Allocator::dealloc(ptr, sz);
+    }
+
+protected:
+
+    //no overload for empty list, the coroutine must have the storage as parameter
+    template<typename First, typename ... Rest>
+    static Allocator &storage(First &first, Rest & ... rest) {
+        if constexpr(std::is_convertible_v<First &, Allocator &>) {
+            return first;
+        } else {
+            return storage(rest...);
+        }
+    }
+};
+
 ///declares coroutine which frame is allocated through the allocator
 /**
  * @tparam Task original coroutine class
@@ -71,7 +112,7 @@ public:
     using Task::Task;
     with_allocator(Task &&arg):Task(std::move(arg)) {}
 
-    using promise_type = custom_allocator_base<Allocator, typename Task::promise_type>;
+    //promise type depends on parameters of the coroutine, see std::coroutine_traits below
 
 
 };
@@ -90,8 +131,173 @@ public:
 };
 
 
+///Storage which recycles small blocks through thread local caches
+/**
+ * Sizes of blocks are rounded up to size classes (multiples of granularity). A released
+ * block is kept in a free list of the thread which releases it, and it is reused by
+ * next allocation of the same size class. So short living objects, as callback futures
+ * created by make_promise(), don't call the global allocator in steady state. Blocks
+ * larger than max_size are allocated by operator new.
+ *
+ * The storage has no state, all instances share the thread local caches. You
+ * can use slab_storage::instance where a reference to the storage is needed
+ *
+ * @code
+ * auto p = make_promise<int>([](future<int> &f){...}, slab_storage::instance);
+ * @endcode
+ *
+ * Blocks can migrate between threads. When the cache of the releasing thread is full,
+ * its blocks are moved to a shared list, where other threads find them when their
+ * caches are empty. So a thread which only allocates (a producer of promises resolved
+ * by other thread) reuses blocks released by the other thread.
+ *
+ * Blocks released during destruction of thread local variables, after the cache of
+ * the thread has been destroyed, go directly to the shared list
+ */
+class slab_storage {
+public:
+    ///sizes are rounded up to multiple of this value
+    static constexpr std::size_t granularity = 16;
+    ///count of size classes
+    static constexpr unsigned int size_classes = 16;
+    ///largest block kept in the cache
+    static constexpr std::size_t max_size = granularity * size_classes;
+    ///maximum count of cached blocks of one size class per thread
+    static constexpr unsigned int max_cached = 64;
+    ///maximum count of blocks of one size class in the shared list
+    static constexpr unsigned int max_shared = max_cached * 4;
+
+    static void *alloc(std::size_t sz) {
+        if (sz <= max_size) {
+            unsigned int cls = size_class(sz);
+            thread_cache *c = cache();
+            if (c) {
+                if (!c->_free[cls]) c->_count[cls] = shared().take(cls, c->_free[cls]);
+                block *b = c->_free[cls];
+                if (b) {
+                    c->_free[cls] = b->_next;
+                    --c->_count[cls];
+                    return b;
+                }
+            }
+            return ::operator new((cls + 1) * granularity);
+        }
+        return ::operator new(sz);
+    }
+
+    static void dealloc(void *ptr, std::size_t sz) {
+        if (sz <= max_size) {
+            unsigned int cls = size_class(sz);
+            thread_cache *c = cache();
+            if (!c) {
+                if (shared().put(cls, new(ptr) block{nullptr}, 1)) return;
+            } else if (c->_count[cls] < max_cached) {
+                c->_free[cls] = new(ptr) block{c->_free[cls]};
+                ++c->_count[cls];
+                return;
+            } else if (shared().put(cls, c->_free[cls], c->_count[cls])) {
+                //whole cache has been passed to other threads
+                c->_free[cls] = new(ptr) block{nullptr};
+                c->_count[cls] = 1;
+                return;
+            }
+        }
+        ::operator delete(ptr);
+    }
+
+    ///Shared instance
+    static slab_storage instance;
+
+protected:
+
+    struct block {
+        block *_next;
+    };
+
+    struct thread_cache {
+        block *_free[size_classes] = {};
+        unsigned int _count[size_classes] = {};
+
+        thread_cache() = default;
+        thread_cache(const thread_cache &) = delete;
+        thread_cache &operator=(const thread_cache &) = delete;
+        ~thread_cache() {
+            _destroyed = true;
+            for (unsigned int cls = 0; cls < size_classes; cls++) {
+                if (!_free[cls] || shared().put(cls, _free[cls], _count[cls])) continue;
+                block *b = _free[cls];
+                while (b) {
+                    block *x = b;
+                    b = b->_next;
+                    ::operator delete(x);
+                }
+            }
+        }
+    };
+
+    //blocks passed between threads
+    struct shared_cache {
+        std::mutex _mx;
+        block *_free[size_classes] = {};
+        std::atomic<unsigned int> _count[size_classes] = {};
+
+        //put list of count blocks, fails when the list is full
+        bool put(unsigned int cls, block *list, unsigned int count) {
+            block *tail = list;
+            while (tail->_next) tail = tail->_next;
+            std::lock_guard _(_mx);
+            unsigned int cnt = _count[cls].load(std::memory_order_relaxed);
+            if (cnt + count > max_shared) return false;
+            tail->_next = _free[cls];
+            _free[cls] = list;
+            _count[cls].store(cnt + count, std::memory_order_relaxed);
+            return true;
+        }
+
+        //take all blocks, returns count of blocks
+        unsigned int take(unsigned int cls, block *&list) {
+            if (!_count[cls].load(std::memory_order_relaxed)) return 0;
+            std::lock_guard _(_mx);
+            list = std::exchange(_free[cls], nullptr);
+            return _count[cls].exchange(0, std::memory_order_relaxed);
+        }
+    };
+
+    //set when the cache of the current thread has been destroyed
+    static inline thread_local bool _destroyed = false;
+
+    //returns nullptr after the cache has been destroyed
+    static thread_cache *cache() {
+        if (_destroyed) return nullptr;
+        static thread_local thread_cache c;
+        return &c;
+    }
+
+    //never destroyed, so it is available during destruction of static variables
+    static shared_cache &shared() {
+        static shared_cache *s = new shared_cache;
+        return *s;
+    }
+
+    static constexpr unsigned int size_class(std::size_t sz) {
+        return sz?static_cast<unsigned int>((sz - 1) / granularity):0;
+    }
+};
+
+inline slab_storage slab_storage::instance;
+
+
 }
 
+namespace std {
+
+///promise of with_allocator receives types of parameters of the coroutine
+template<typename Allocator, typename Task, typename ... Params>
+struct coroutine_traits<cocls::with_allocator<Allocator, Task>, Params...> {
+    using promise_type = cocls::coro_allocator_base<Allocator, typename Task::promise_type, Params...>;
+};
+
+}
 
 
 #endif /* SRC_cocls_SRC_cocls_WITH_ALLOCATOR_H_ */
@@ -0,0 +1,104 @@
+#include "check.h"
+#include <cocls/actor.h>
+
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+class counter: public cocls::actor<int, int> {
+public:
+    using cocls::actor<int, int>::actor;
+
+    std::atomic<int> _inside = 0;
+    std::atomic<int> _overlaps = 0;
+
+protected:
+    int _sum = 0;
+
+    int receive(int &&v) override {
+        if (++_inside > 1) ++_overlaps;
+        if (v < 0) {
+            --_inside;
+            throw std::invalid_argument("negative");
+        }
+        _sum += v;
+        --_inside;
+        return _sum;
+    }
+};
+
+class gated: public cocls::actor<int> {
+public:
+    gated(cocls::thread_pool &pool, std::size_t capacity):cocls::actor<int>(pool, capacity) {}
+
+    std::atomic<bool> _open = false;
+    std::vector<int> _received;
+
+protected:
+    void receive(int &&v) override {
+        while (!_open) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        _received.push_back(v);
+    }
+};
+
+cocls::async<void> producer(gated &a, int first, int count) {
+    for (int i = 0; i < count; i++) {
+        co_await a.send(first + i);
+    }
+}
+
+int main() {
+    {
+        cocls::thread_pool pool(4);
+        counter c(pool);
+        std::vector<std::thread> thrs;
+        for (int t = 0; t < 4; t++) {
+            thrs.push_back(std::thread([&]{
+                for (int i = 1; i <= 1000; i++) c.tell(std::move(i));
+            }));
+        }
+        for (auto &t: thrs) t.join();
+        int sum = c.ask(0).wait();
+        CHECK_EQUAL(sum, 4*500500);
+        CHECK_EQUAL(c._overlaps.load(), 0);
+        CHECK_EXCEPTION(std::invalid_argument, c.ask(-1).wait());
+        int sum2 = c.ask(5).wait();
+        CHECK_EQUAL(sum2, 4*500500+5);
+    }
+    {
+        //actor is destroyed right after the reply, the destructor waits for the activation
+        cocls::thread_pool pool(4);
+        int total = 0;
+        for (int i = 0; i < 500; i++) {
+            counter c(pool);
+            total += c.ask(1).wait();
+        }
+        CHECK_EQUAL(total, 500);
+    }
+    {
+        cocls::thread_pool pool(4);
+        gated g(pool, 2);
+        g.tell(1);
+        g.tell(2);
+        bool ok = g.try_send(3);
+        //first message may be already taken by the activation, but it still occupies the slot
+        CHECK(!ok);
+        CHECK_EXCEPTION(cocls::mailbox_full_exception, g.tell(3));
+        auto f1 = producer(g, 100, 10).start();
+        auto f2 = producer(g, 200, 10).start();
+        g._open = true;
+        f1.wait();
+        f2.wait();
+        g.send(1000).wait();
+        g.ask(0).wait();
+        CHECK_EQUAL(g._received.size(), 24u);
+        CHECK_EQUAL(g._received.front(), 1);
+        CHECK_EQUAL(g._received.back(), 0);
+        //messages of single producer are received in order
+        int last1 = 0, last2 = 0;
+        for (int v: g._received) {
+            if (v >= 100 && v < 200) {CHECK_LESS(last1, v); last1 = v;}
+            if (v >= 200 && v < 300) {CHECK_LESS(last2, v); last2 = v;}
+        }
+    }
+}
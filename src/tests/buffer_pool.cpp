@@ -0,0 +1,121 @@
+#include "check.h"
+#include <cocls/buffer_pool.h>
+#include <cocls/async.h>
+#include <cocls/queue.h>
+#include <cocls/thread_pool.h>
+#ifdef __linux__
+#include <cocls/io_ring.h>
+#include <cstdlib>
+#endif
+
+#include <cstring>
+#include <vector>
+
+cocls::async<void> producer(cocls::buffer_pool &bp, cocls::queue<cocls::buffer_ref> &q, int count) {
+    for (int i = 0; i < count; i++) {
+        cocls::buffer_ref b = bp.acquire();
+        while (!b) {
+            //all buffers are in flight, wait for the consumer
+            std::this_thread::yield();
+            b = bp.acquire();
+        }
+        std::memcpy(b.data(), &i, sizeof(i));
+        b.shrink(sizeof(i));
+        //switch to the consumer, it releases the buffer
+        co_await q.push(std::move(b));
+    }
+    q.push(cocls::buffer_ref());
+    co_return;
+}
+
+cocls::async<long> consumer(cocls::queue<cocls::buffer_ref> &q) {
+    long sum = 0;
+    for(;;) {
+        cocls::buffer_ref b = co_await q.pop();
+        if (!b) break;
+        int v;
+        std::memcpy(&v, b.data(), sizeof(v));
+        sum += v;
+    }
+    co_return sum;
+}
+
+int main() {
+    {
+        cocls::buffer_pool bp(256, 4);
+        std::vector<cocls::buffer_ref> bufs;
+        for (int i = 0; i < 4; i++) {
+            bufs.push_back(bp.acquire());
+            CHECK(static_cast<bool>(bufs.back()));
+        }
+        CHECK(!bp.acquire());
+        auto s = bufs[0].slice(10, 20);
+        auto cnt = s.use_count();
+        CHECK_EQUAL(cnt, 2);
+        CHECK_EQUAL(s.size(), 20);
+        CHECK(s.data() == bufs[0].data() + 10);
+        bufs.clear();
+        //slice keeps the buffer, others are back in the pool
+        auto a = bp.acquire();
+        auto b = bp.acquire();
+        auto c = bp.acquire();
+        CHECK(a && b && c);
+        CHECK(!bp.acquire());
+        s = cocls::buffer_ref();
+        CHECK(static_cast<bool>(bp.acquire()));
+    }
+
+    {
+        //buffers cached by other thread are not lost for acquire()
+        cocls::buffer_pool bp(64, 4);
+        auto take_all = [&]{
+            std::vector<cocls::buffer_ref> bufs;
+            for (int i = 0; i < 4; i++) {
+                auto b = bp.acquire();
+                if (b) bufs.push_back(std::move(b));
+            }
+            return bufs.size();
+        };
+        //released buffers stay in the cache of this thread
+        std::size_t n1 = take_all();
+        std::size_t n2 = 0;
+        std::thread thr([&]{n2 = take_all();});
+        thr.join();
+        CHECK_EQUAL(n1, 4u);
+        CHECK_EQUAL(n2, 4u);
+    }
+
+    {
+        //buffers travel through the queue between threads without copying
+        cocls::buffer_pool bp(64, 32);
+        cocls::thread_pool pool(2);
+        cocls::queue<cocls::buffer_ref> q;
+        auto f = consumer(q).start();
+        std::thread thr([&]{producer(bp, q, 10000).join();});
+        long sum = f.wait();
+        thr.join();
+        CHECK_EQUAL(sum, 49995000L);
+    }
+
+#ifdef __linux__
+    {
+        char name[] = "/tmp/cocls_buffer_pool_XXXXXX";
+        int fd = mkstemp(name);
+        CHECK_GREATER_EQUAL(fd, 0);
+        unlink(name);
+        cocls::buffer_pool bp(4096, 8);
+        cocls::thread_pool pool(2);
+        cocls::io_ring ring(pool);
+        ring.register_buffers(bp);
+        auto w = bp.acquire();
+        std::memset(w.data(), 'x', w.size());
+        std::size_t wr = ring.write(fd, w, 0).wait();
+        CHECK_EQUAL(wr, 4096);
+        auto r = bp.acquire();
+        std::size_t rd = ring.read(fd, r.slice(100), 100).wait();
+        CHECK_EQUAL(rd, 3996);
+        CHECK_EQUAL(r.data()[4095], 'x');
+        ::close(fd);
+    }
+#endif
+}
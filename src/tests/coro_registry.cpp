@@ -0,0 +1,90 @@
+#define COCLS_CORO_REGISTRY
+#include "check.h"
+#include <cocls/async.h>
+#include <cocls/generator.h>
+#include <cocls/mutex.h>
+#include <cocls/scheduler.h>
+#include <cocls/thread_pool.h>
+
+#include <cstring>
+
+cocls::async<int> forgotten(cocls::future<int> &f) {
+    int v = co_await f;
+    co_return v;
+}
+
+cocls::async<void> lock_it(cocls::mutex &mx) {
+    auto own = co_await mx.lock();
+}
+
+cocls::generator<int> gen() {
+    co_yield 1;
+}
+
+std::size_t count_live() {
+    return cocls::coro_registry::snapshot().size();
+}
+
+int main() {
+    {
+        cocls::future<int> f;
+        auto p = f.get_promise();
+        auto res = forgotten(f).start();
+        auto lst = cocls::coro_registry::snapshot();
+        CHECK_EQUAL(lst.size(), 1);
+        CHECK(lst[0].awaiting == &f);
+        CHECK_EQUAL(std::strcmp(lst[0].kind, "future"), 0);
+        CHECK(lst[0].type == cocls::coro_type::async);
+        auto stuck = cocls::coro_registry::stuck(std::chrono::milliseconds(10));
+        CHECK(stuck.empty());
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        stuck = cocls::coro_registry::stuck(std::chrono::milliseconds(10));
+        CHECK_EQUAL(stuck.size(), 1);
+        p(42);
+        int v = res.wait();
+        CHECK_EQUAL(v, 42);
+        auto live = count_live();
+        CHECK_EQUAL(live, 0);
+    }
+
+    {
+        cocls::mutex mx;
+        auto own = mx.try_lock();
+        auto res = lock_it(mx).start();
+        auto lst = cocls::coro_registry::snapshot();
+        CHECK_EQUAL(lst.size(), 1);
+        CHECK_EQUAL(std::strcmp(lst[0].kind, "mutex"), 0);
+        own.release();
+        res.wait();
+    }
+
+    {
+        auto g = gen();
+        auto lst = cocls::coro_registry::snapshot();
+        CHECK_EQUAL(lst.size(), 1);
+        CHECK(lst[0].type == cocls::coro_type::generator);
+        CHECK(lst[0].awaiting == nullptr);
+    }
+
+    {
+        cocls::thread_pool pool(2);
+        cocls::scheduler sch(pool);
+        std::stop_source stop;
+        std::atomic<int> reports = 0;
+        std::atomic<const void *> reported = nullptr;
+        cocls::future<int> f;
+        auto p = f.get_promise();
+        auto res = forgotten(f).start();
+        auto wd = sch.watchdog(std::chrono::milliseconds(20), std::chrono::milliseconds(10), [&](const std::vector<cocls::coro_info> &lst){
+            reported = lst[0].awaiting;
+            ++reports;
+        }, stop.get_token()).start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        stop.request_stop();
+        wd.wait();
+        CHECK_GREATER(reports.load(), 0);
+        CHECK(reported.load() == &f);
+        p(1);
+        res.wait();
+    }
+}
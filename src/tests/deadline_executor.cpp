@@ -0,0 +1,89 @@
+#include "check.h"
+#include <cocls/deadline_executor.h>
+#include <cocls/async.h>
+
+#include <string>
+
+using namespace std::chrono_literals;
+
+cocls::async<std::thread::id> transfer(cocls::deadline_executor &exec, cocls::deadline_executor::time_point tp) {
+    co_await exec.before(tp);
+    co_return std::this_thread::get_id();
+}
+
+cocls::async<bool> late(cocls::deadline_executor &exec) {
+    try {
+        co_await exec.within(-1ms);
+        co_return false;
+    } catch (const cocls::deadline_missed_exception &) {
+        co_return true;
+    }
+}
+
+cocls::async<int> wait_value(cocls::future<int> &f, std::thread::id &id) {
+    int v = co_await f;
+    id = std::this_thread::get_id();
+    co_return v;
+}
+
+int main() {
+    auto now = cocls::deadline_executor::clock::now();
+
+    {
+        //work is dispatched in order of deadlines
+        cocls::deadline_executor exec(1);
+        std::atomic<bool> gate = false;
+        std::string order;
+        auto blk = exec.run([&]{gate.wait(false);}, now + 10s);
+        auto f3 = exec.run([&]{order.push_back('3');}, now + 3s);
+        auto f1 = exec.run([&]{order.push_back('1');}, now + 1s);
+        auto f2 = exec.run([&]{order.push_back('2');}, now + 2s);
+        gate = true;
+        gate.notify_all();
+        f3.wait();
+        CHECK_EQUAL(order, "123");
+        CHECK_EQUAL(exec.get_missed(), 0u);
+    }
+
+    {
+        //missed work is not executed and it is reported
+        cocls::deadline_executor exec(1);
+        std::atomic<int> reported = 0;
+        exec.set_miss_handler([&](auto, auto late){
+            if (late > 0ms) ++reported;
+        });
+        bool called = false;
+        auto f = exec.run([&]{called = true;return 1;}, now - 1ms);
+        CHECK_EXCEPTION(cocls::deadline_missed_exception, f.wait());
+        CHECK(!called);
+        bool missed = late(exec).join();
+        CHECK(missed);
+        CHECK_EQUAL(exec.get_missed(), 2u);
+        CHECK_EQUAL(reported.load(), 2);
+    }
+
+    {
+        //coroutines
+        cocls::deadline_executor exec(2);
+        auto id = transfer(exec, cocls::deadline_executor::clock::now() + 1s).join();
+        CHECK_NOT_EQUAL(id, std::this_thread::get_id());
+
+        //suspend_point is resumed in the executor
+        cocls::future<int> f;
+        auto p = f.get_promise();
+        std::thread::id id2;
+        auto res = wait_value(f, id2).start();
+        exec.resume(p(42), cocls::deadline_executor::clock::now() + 1s);
+        int v = res.wait();
+        CHECK_EQUAL(v, 42);
+        CHECK_NOT_EQUAL(id2, std::this_thread::get_id());
+    }
+
+    {
+        //stopped executor cancels the work
+        cocls::deadline_executor exec(1);
+        exec.stop();
+        auto f = exec.run([]{return 1;}, now + 1s);
+        CHECK_EXCEPTION(cocls::await_canceled_exception, f.wait());
+    }
+}
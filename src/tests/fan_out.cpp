@@ -0,0 +1,78 @@
+#include "check.h"
+#include <cocls/future.h>
+#include <cocls/async.h>
+#include <cocls/signal.h>
+#include <cocls/thread_pool.h>
+
+#include <atomic>
+#include <thread>
+
+static constexpr int waiters = 100;
+
+cocls::async<void> wait_future(cocls::future<int> &f, std::atomic<int> &sum,
+        std::atomic<int> &in_main, std::atomic<int> &done, std::thread::id main_id) {
+    int v = co_await f;
+    sum += v;
+    if (std::this_thread::get_id() == main_id) ++in_main;
+    if (++done == waiters) done.notify_all();
+}
+
+cocls::async<void> wait_signal(cocls::signal<int>::emitter em, std::atomic<int> &sum,
+        std::atomic<int> &done) {
+    int v = co_await em;
+    sum += v;
+    if (++done == waiters) done.notify_all();
+}
+
+void wait_done(std::atomic<int> &done) {
+    int v = done.load();
+    while (v != waiters) {
+        done.wait(v);
+        v = done.load();
+    }
+}
+
+int main() {
+    cocls::thread_pool pool(4);
+    auto main_id = std::this_thread::get_id();
+
+    {
+        std::atomic<int> sum = 0, in_main = 0, done = 0;
+        cocls::future<int> f;
+        auto p = f.get_promise();
+        for (int i = 0; i < waiters; i++) {
+            wait_future(f, sum, in_main, done, main_id).detach();
+        }
+        bool r = pool.fan_out(p(2), 7);
+        CHECK(r);
+        wait_done(done);
+        CHECK_EQUAL(sum.load(), 2*waiters);
+        CHECK_EQUAL(in_main.load(), 0);
+    }
+
+    {
+        std::atomic<int> sum = 0, done = 0;
+        cocls::signal<int> sig;
+        for (int i = 0; i < waiters; i++) {
+            wait_signal(sig.get_emitter(), sum, done).detach();
+        }
+        auto collector = sig.get_collector();
+        pool.fan_out(collector(3));
+        wait_done(done);
+        CHECK_EQUAL(sum.load(), 3*waiters);
+    }
+
+    {
+        std::atomic<int> sum = 0, in_main = 0, done = 0;
+        cocls::future<int> f;
+        auto p = f.get_promise();
+        for (int i = 0; i < waiters; i++) {
+            wait_future(f, sum, in_main, done, main_id).detach();
+        }
+        pool.stop();
+        //stopped pool - coroutines are resumed in current thread
+        pool.fan_out(p(1));
+        CHECK_EQUAL(done.load(), waiters);
+        CHECK_EQUAL(in_main.load(), waiters);
+    }
+}
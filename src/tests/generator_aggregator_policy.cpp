@@ -0,0 +1,65 @@
+#include <cocls/generator_aggregator.h>
+
+#include <cocls/generator.h>
+#include "check.h"
+
+#include <string>
+
+cocls::generator<int> co_repeat(int value, int count) {
+    for (int i = 0; i < count; i++) {
+        co_yield value;
+    }
+}
+
+cocls::generator<int> co_sorted(std::vector<int> items) {
+    for (int &x: items) {
+        co_yield x;
+    }
+}
+
+std::string collect(cocls::generator<int> gen) {
+    std::string out;
+    for (int x: gen) out.append(std::to_string(x));
+    return out;
+}
+
+int main(int, char **) {
+
+    {
+        std::vector<cocls::generator<int> > gens;
+        gens.push_back(co_repeat(1, 6));
+        gens.push_back(co_repeat(2, 3));
+        gens.push_back(co_repeat(3, 2));
+        auto out = collect(cocls::generator_aggregator(std::move(gens),
+                cocls::aggregator_policy::round_robin, {2,1,1}));
+        CHECK_EQUAL(out, "11231123112");
+    }
+
+    {
+        std::vector<cocls::generator<int> > gens;
+        gens.push_back(co_repeat(1, 2));
+        gens.push_back(co_repeat(2, 2));
+        gens.push_back(co_repeat(3, 2));
+        auto out = collect(cocls::generator_aggregator(std::move(gens),
+                cocls::aggregator_policy::priority, {1,5,3}));
+        CHECK_EQUAL(out, "223311");
+    }
+
+    {
+        std::vector<cocls::generator<int> > gens;
+        gens.push_back(co_sorted({1,4,7,9}));
+        gens.push_back(co_sorted({2,3,8}));
+        gens.push_back(co_sorted({}));
+        gens.push_back(co_sorted({0,5,6}));
+        auto out = collect(cocls::merge_sorted(std::move(gens)));
+        CHECK_EQUAL(out, "0123456789");
+    }
+
+    {
+        std::vector<cocls::generator<int> > gens;
+        gens.push_back(co_sorted({9,5,1}));
+        gens.push_back(co_sorted({8,6,2,0}));
+        auto out = collect(cocls::merge_sorted(std::move(gens), std::greater<int>()));
+        CHECK_EQUAL(out, "9865210");
+    }
+}
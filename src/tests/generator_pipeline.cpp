@@ -0,0 +1,86 @@
+#include "check.h"
+#include <cocls/generator_pipeline.h>
+#include <cocls/thread_pool.h>
+
+#include <string>
+
+cocls::generator<int> co_numbers(int count) {
+    for (int i = 1; i <= count; i++) {
+        co_yield i;
+    }
+}
+
+cocls::generator<int> co_numbers_async(int count, cocls::thread_pool &pool) {
+    for (int i = 1; i <= count; i++) {
+        co_await pool;
+        co_yield i;
+    }
+}
+
+cocls::generator<int> co_failing(int count) {
+    for (int i = 1; i <= count; i++) {
+        co_yield i;
+    }
+    throw std::runtime_error("failed");
+}
+
+int main() {
+    cocls::thread_pool pool(2);
+
+    {
+        auto gen = cocls::map(cocls::filter(co_numbers(10), [](int x){return x % 2 == 0;}),
+                [](int x){return std::to_string(x*10);});
+        std::string out;
+        for (auto &x: gen) out.append(x).append(",");
+        CHECK_EQUAL(out, "20,40,60,80,100,");
+    }
+
+    {
+        auto gen = cocls::batch(cocls::take(co_numbers(100), 7), 3);
+        int sizes[] = {3,3,1};
+        int pos = 0;
+        int sum = 0;
+        for (auto &b: gen) {
+            CHECK_EQUAL(static_cast<int>(b.size()), sizes[pos]);
+            for (int x: b) sum += x;
+            ++pos;
+        }
+        CHECK_EQUAL(pos, 3);
+        CHECK_EQUAL(sum, 28);
+    }
+
+    {
+        auto gen = cocls::buffer(co_numbers(1000), 16, pool);
+        int sum = 0;
+        int expect = 1;
+        bool ordered = true;
+        for (int x: gen) {
+            sum += x;
+            ordered = ordered && x == expect;
+            ++expect;
+        }
+        CHECK(ordered);
+        CHECK_EQUAL(sum, 500500);
+    }
+
+    {
+        auto gen = cocls::buffer(co_numbers_async(100, pool), 4, pool);
+        int sum = 0;
+        while (gen.next()) sum += gen.value();
+        CHECK_EQUAL(sum, 5050);
+    }
+
+    {
+        //destroy buffered generator before the source is finished
+        auto gen = cocls::buffer(co_numbers_async(1000, pool), 4, pool);
+        CHECK(gen.next());
+        CHECK_EQUAL(gen.value(), 1);
+    }
+
+    {
+        auto gen = cocls::buffer(co_failing(3), 2, pool);
+        int sum = 0;
+        CHECK_EXCEPTION(std::runtime_error, for (int x: gen) sum += x);
+        CHECK_EQUAL(sum, 6);
+    }
+}
@@ -0,0 +1,55 @@
+#include "check.h"
+#include <cocls/generator_pipeline.h>
+#include <cocls/thread_pool.h>
+
+#include <atomic>
+#include <chrono>
+
+cocls::generator<int> co_counted(int count, int &produced) {
+    for (int i = 1; i <= count; i++) {
+        ++produced;
+        co_yield i;
+    }
+}
+
+cocls::generator<int> co_pages(int count, cocls::thread_pool &pool, std::atomic<int> &produced) {
+    for (int i = 1; i <= count; i++) {
+        co_await pool;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ++produced;
+        co_yield i;
+    }
+}
+
+int main() {
+    {
+        int produced = 0;
+        auto gen = cocls::read_ahead(co_counted(20, produced), 5);
+        CHECK(gen.next());
+        CHECK_EQUAL(gen.value(), 1);
+        CHECK_EQUAL(produced, 5);
+        CHECK(gen.next());
+        CHECK_EQUAL(gen.value(), 2);
+        CHECK_EQUAL(produced, 6);
+        int sum = 3;
+        for (int x: gen) sum += x;
+        CHECK_EQUAL(sum, 210);
+        CHECK_EQUAL(produced, 20);
+    }
+
+    {
+        cocls::thread_pool pool(2);
+        std::atomic<int> produced = 0;
+        auto gen = cocls::read_ahead(co_pages(50, pool, produced), 4);
+        int sum = 0;
+        for (;;) {
+            auto f = gen();
+            if (!f.has_value()) break;
+            sum += *f;
+            //let the producer work ahead
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            CHECK_LESS_EQUAL(produced.load(), *f + 5);
+        }
+        CHECK_EQUAL(sum, 1275);
+    }
+}
@@ -0,0 +1,76 @@
+#define COCLS_INSTRUMENTATION
+#include "check.h"
+#include <cocls/async.h>
+#include <cocls/mutex.h>
+#include <cocls/publisher.h>
+#include <cocls/queue.h>
+#include <cocls/scheduler.h>
+#include <cocls/thread_pool.h>
+
+#include <sstream>
+
+using namespace cocls::instrumentation;
+
+cocls::async<int> consume(cocls::queue<int> &q) {
+    int v = co_await q.pop();
+    co_return v;
+}
+
+cocls::async<void> locker(cocls::mutex &mx, cocls::thread_pool &pool) {
+    co_await pool;
+    auto own = co_await mx.lock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+}
+
+int main() {
+    static_assert(bucket_index(0) == 0);
+    static_assert(bucket_index(5) == 5);
+    static_assert(bucket_lower_bound(bucket_index(1000)) <= 1000);
+    static_assert(bucket_lower_bound(bucket_index(1000)+1) > 1000);
+
+    {
+        cocls::queue<int> q;
+        auto f = consume(q).start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        q.push(42);
+        int v = f.wait();
+        CHECK_EQUAL(v, 42);
+        auto s = take_snapshot();
+        CHECK_EQUAL(s[histogram::queue_wait_time].count, 1);
+        CHECK_GREATER_EQUAL(s[histogram::queue_wait_time].max, 10000000u);
+    }
+
+    {
+        cocls::thread_pool pool(2);
+        cocls::mutex mx;
+        auto f1 = locker(mx, pool).start();
+        auto f2 = locker(mx, pool).start();
+        f1.wait();
+        f2.wait();
+        auto s = take_snapshot();
+        CHECK_EQUAL(s[counter::mutex_lock] + s[counter::mutex_contended], 2);
+        CHECK_GREATER_EQUAL(s[histogram::thread_pool_dispatch_latency].count, 2u);
+        CHECK_GREATER_EQUAL(s[histogram::thread_pool_queue_depth].count, 2u);
+    }
+
+    {
+        cocls::scheduler sch;
+        sch.schedule(nullptr, cocls::make_promise<void>([](auto &){}), std::chrono::system_clock::now() - std::chrono::milliseconds(2));
+        auto e = sch.get_expired(std::chrono::system_clock::now());
+        CHECK(std::holds_alternative<cocls::scheduler::promise>(e));
+        auto s = take_snapshot();
+        CHECK_EQUAL(s[histogram::scheduler_timers].count, 1);
+        CHECK_GREATER_EQUAL(s[histogram::scheduler_lateness].percentile(50), 1000000u);
+    }
+
+    {
+        //values of finished threads are kept
+        std::thread thr([]{record(histogram::publisher_lag, 7);});
+        thr.join();
+        auto s = take_snapshot();
+        CHECK_EQUAL(s[histogram::publisher_lag].max, 7);
+        std::ostringstream out;
+        out << s;
+        CHECK(out.str().find("publisher_lag count=1") != std::string::npos);
+    }
+}
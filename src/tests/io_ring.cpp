@@ -0,0 +1,104 @@
+#include "check.h"
+#include <cocls/io_ring.h>
+
+#ifdef __linux__
+
+#include <cocls/async.h>
+#include <cocls/thread_pool.h>
+
+#include <cstdlib>
+#include <string>
+#include <sys/socket.h>
+
+constexpr std::size_t chunk = 1000;
+constexpr std::size_t chunks = 16;
+
+cocls::async<void> write_chunk(cocls::io_ring &ring, int fd, std::size_t idx) {
+    std::string data(chunk, static_cast<char>('a' + idx));
+    std::size_t sz = co_await ring.write(fd, data, idx * chunk);
+    if (sz != chunk) throw std::runtime_error("short write");
+}
+
+cocls::async<std::size_t> read_chunk(cocls::io_ring &ring, int fd, std::size_t idx) {
+    char buff[chunk];
+    std::size_t sz = co_await ring.read(fd, buff, idx * chunk);
+    std::size_t ok = 0;
+    for (std::size_t i = 0; i < sz; i++) ok += buff[i] == static_cast<char>('a' + idx);
+    co_return ok;
+}
+
+cocls::async<std::string> echo(cocls::io_ring &ring, int fd) {
+    char buff[64];
+    std::size_t sz = co_await ring.read(fd, buff);
+    co_await ring.write(fd, std::span<const char>(buff, sz));
+    co_return std::string(buff, sz);
+}
+
+void test_file(cocls::io_ring::backend b) {
+    char name[] = "/tmp/cocls_io_ring_XXXXXX";
+    int fd = mkstemp(name);
+    CHECK_GREATER_EQUAL(fd, 0);
+    unlink(name);
+
+    cocls::thread_pool pool(3);
+    cocls::io_ring ring(pool, 64, b);
+    std::vector<cocls::future<void> > writes(chunks);
+    std::vector<cocls::future<std::size_t> > reads(chunks);
+    //all writes are prepared in single cycle of coroutine queue
+    cocls::coro_queue::install_queue_and_call([&]{
+        for (std::size_t i = 0; i < chunks; i++) writes[i] << [&]{return write_chunk(ring, fd, i).start();};
+    });
+    for (auto &f: writes) f.wait();
+    if (ring.get_backend() == cocls::io_ring::backend::uring) {
+        std::size_t submits = ring.get_submit_count();
+        CHECK_EQUAL(submits, 1);
+    }
+    cocls::coro_queue::install_queue_and_call([&]{
+        for (std::size_t i = 0; i < chunks; i++) reads[i] << [&]{return read_chunk(ring, fd, i).start();};
+    });
+    std::size_t total = 0;
+    for (auto &f: reads) total += f.wait();
+    CHECK_EQUAL(total, chunk * chunks);
+
+    char buff[10];
+    std::size_t eof = ring.read(fd, buff, chunk * chunks).wait();
+    CHECK_EQUAL(eof, 0);
+    CHECK_EXCEPTION(std::system_error, ring.read(-1, buff, 0).wait());
+    ::close(fd);
+}
+
+int main() {
+    test_file(cocls::io_ring::backend::automatic);
+    test_file(cocls::io_ring::backend::blocking);
+
+    int sp[2];
+    int res = socketpair(AF_UNIX, SOCK_STREAM, 0, sp);
+    CHECK_EQUAL(res, 0);
+    {
+        cocls::thread_pool pool(3);
+        cocls::io_ring ring(pool);
+        auto f = echo(ring, sp[0]).start();
+        std::string msg = "hello";
+        auto wr = ::write(sp[1], msg.data(), msg.size());
+        CHECK_EQUAL(wr, 5);
+        std::string data = f.wait();
+        CHECK_EQUAL(data, msg);
+        char buff[10];
+        auto rd = ::read(sp[1], buff, sizeof(buff));
+        CHECK_EQUAL(rd, 5);
+    }
+    ::close(sp[0]);
+    ::close(sp[1]);
+    {
+        //completion loop is dropped by stopped pool, the destructor must not wait for it
+        cocls::thread_pool pool(1);
+        pool.stop();
+        cocls::io_ring ring(pool);
+    }
+}
+
+#else
+
+int main() {}
+
+#endif
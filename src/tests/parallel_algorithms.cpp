@@ -0,0 +1,65 @@
+#include "check.h"
+#include <cocls/parallel_algorithms.h>
+
+#include <numeric>
+#include <stdexcept>
+
+cocls::async<long> score(cocls::thread_pool &pool, std::vector<int> &data) {
+    co_await pool;
+    long sum = co_await cocls::parallel_reduce(pool, data, 100, 0L, [](long acc, int v) {
+        return acc + v;
+    }, std::plus<long>());
+    co_return sum;
+}
+
+int main() {
+    cocls::thread_pool pool(4);
+
+    {
+        std::vector<std::atomic<int> > hits(10000);
+        cocls::parallel_for(pool, 0, 10000, 64, [&](int i){++hits[i];}).wait();
+        bool all_once = std::all_of(hits.begin(), hits.end(), [](const std::atomic<int> &x){return x == 1;});
+        CHECK(all_once);
+    }
+
+    {
+        std::vector<int> data(12345);
+        std::iota(data.begin(), data.end(), 1);
+        cocls::parallel_for(pool, data, 0, [](int &x){x *= 2;}).wait();
+        CHECK_EQUAL(data.back(), 24690);
+        long sum = cocls::parallel_reduce(pool, data, 0, 0L, std::plus<long>()).wait();
+        CHECK_EQUAL(sum, 12345L * 12346L);
+        std::vector<double> out(data.size());
+        cocls::parallel_transform(pool, data, out.begin(), 500, [](int x){return x * 0.5;}).wait();
+        CHECK_EQUAL(out[99], 100.0);
+        long csum = score(pool, data).join();
+        CHECK_EQUAL(csum, sum);
+    }
+
+    {
+        std::vector<int> empty;
+        long sum = cocls::parallel_reduce(pool, empty, 10, 7L, std::plus<long>()).wait();
+        CHECK_EQUAL(sum, 7);
+        cocls::parallel_for(pool, 5, 5, 1, [](int){}).wait();
+    }
+
+    {
+        std::atomic<int> calls = 0;
+        CHECK_EXCEPTION(std::runtime_error, cocls::parallel_for(pool, 0, 1000, 1, [&](int i){
+            ++calls;
+            if (i == 0) throw std::runtime_error("failed");
+        }).wait());
+        CHECK_LESS_EQUAL(calls.load(), 1000);
+    }
+
+    {
+        //chunks dropped by stopped pool cancel the job
+        cocls::thread_pool stopped(2);
+        stopped.stop();
+        std::atomic<int> calls = 0;
+        CHECK_EXCEPTION(cocls::await_canceled_exception, cocls::parallel_for(stopped, 0, 1000, 10, [&](int){
+            ++calls;
+        }).wait());
+        CHECK_EQUAL(calls.load(), 0);
+    }
+}
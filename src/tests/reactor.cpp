@@ -0,0 +1,163 @@
+#include "check.h"
+#include <cocls/reactor.h>
+
+#ifdef __linux__
+
+#include <cocls/async.h>
+#include <cocls/scheduler.h>
+#include <cocls/thread_pool.h>
+
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+
+cocls::async<std::string> read_all(cocls::reactor &r, int fd) {
+    std::string out;
+    char buff[4];
+    for (;;) {
+        std::size_t sz = co_await r.read(fd, buff);
+        if (sz == 0) break;
+        out.append(buff, sz);
+    }
+    co_return out;
+}
+
+cocls::async<std::size_t> write_all(cocls::reactor &r, int fd, std::size_t total) {
+    std::string data(4096, 'x');
+    std::size_t written = 0;
+    while (written < total) {
+        co_await r.writable(fd);
+        std::size_t sz = co_await r.write(fd, std::span<const char>(data.data(), std::min(data.size(), total - written)));
+        written += sz;
+    }
+    co_return written;
+}
+
+cocls::async<int> read_timeout(cocls::reactor &r, int fd) {
+    char buff[4];
+    try {
+        co_await r.read(fd, buff, std::chrono::milliseconds(50));
+        co_return 1;
+    } catch (const cocls::await_timeout_exception &) {
+        co_return 2;
+    }
+}
+
+cocls::async<int> wait_canceled(cocls::reactor &r, int fd) {
+    try {
+        co_await r.readable(fd);
+        co_return 1;
+    } catch (const cocls::await_canceled_exception &) {
+        co_return 2;
+    }
+}
+
+cocls::async<void> single_thread(cocls::reactor &r, cocls::scheduler &sch, int rd, int wr, int &result) {
+    co_await sch.sleep_for(std::chrono::milliseconds(10));
+    result = co_await read_timeout(r, rd);
+    co_await r.write(wr, std::span<const char>("abc", 3));
+    char buff[3];
+    result = result * 10 + static_cast<int>(co_await r.read(rd, buff));
+    r.stop();
+}
+
+int main() {
+    int sp[2];
+    int res = socketpair(AF_UNIX, SOCK_STREAM, 0, sp);
+    CHECK_EQUAL(res, 0);
+    cocls::reactor::set_nonblocking(sp[0]);
+    cocls::reactor::set_nonblocking(sp[1]);
+
+    {
+        cocls::thread_pool pool(2);
+        cocls::reactor r;
+        r.start_in(pool);
+        //timeout needs a scheduler
+        CHECK_EXCEPTION(std::logic_error, (void)r.readable(sp[0], std::chrono::milliseconds(10)));
+        auto f = read_all(r, sp[0]).start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        std::string msg = "hello world";
+        auto wr = ::write(sp[1], msg.data(), msg.size());
+        CHECK_EQUAL(wr, static_cast<ssize_t>(msg.size()));
+        ::shutdown(sp[1], SHUT_WR);
+        std::string data = f.wait();
+        CHECK_EQUAL(data, msg);
+    }
+
+    {
+        int p[2];
+        res = pipe(p);
+        CHECK_EQUAL(res, 0);
+        cocls::reactor::set_nonblocking(p[0]);
+        cocls::reactor::set_nonblocking(p[1]);
+        std::thread thr;
+        cocls::reactor r;
+        r.start_in(thr);
+        //more than capacity of the pipe, so the writer must wait
+        constexpr std::size_t total = 1024*1024;
+        auto w = write_all(r, p[1], total).start();
+        std::size_t rd = 0;
+        char buff[65536];
+        while (rd < total) {
+            auto sz = ::read(p[0], buff, sizeof(buff));
+            if (sz > 0) rd += sz;
+            else std::this_thread::yield();
+        }
+        std::size_t written = w.wait();
+        CHECK_EQUAL(written, total);
+        CHECK_EQUAL(rd, total);
+        auto c = wait_canceled(r, p[0]).start();
+        r.cancel(p[0]);
+        int canceled = c.wait();
+        CHECK_EQUAL(canceled, 2);
+        r.stop();
+        thr.join();
+        ::close(p[0]);
+        ::close(p[1]);
+    }
+
+    {
+        int p[2];
+        res = socketpair(AF_UNIX, SOCK_STREAM, 0, p);
+        CHECK_EQUAL(res, 0);
+        cocls::reactor::set_nonblocking(p[0]);
+        cocls::reactor::set_nonblocking(p[1]);
+        cocls::thread_pool pool(2);
+        cocls::scheduler sch(pool);
+        cocls::reactor r(sch);
+        r.start_in(pool);
+        auto t1 = std::chrono::system_clock::now();
+        int timedout = read_timeout(r, p[0]).join();
+        CHECK_EQUAL(timedout, 2);
+        auto t2 = std::chrono::system_clock::now();
+        CHECK_GREATER_EQUAL(std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count(), 50);
+        ::close(p[0]);
+        ::close(p[1]);
+    }
+
+    {
+        //reactor serves scheduler in the same thread
+        int p[2];
+        res = socketpair(AF_UNIX, SOCK_STREAM, 0, p);
+        CHECK_EQUAL(res, 0);
+        cocls::reactor::set_nonblocking(p[0]);
+        cocls::reactor::set_nonblocking(p[1]);
+        cocls::scheduler sch;
+        cocls::reactor r(sch);
+        int result = 0;
+        single_thread(r, sch, p[0], p[1], result).detach();
+        r.run(sch);
+        CHECK_EQUAL(result, 23);
+        ::close(p[0]);
+        ::close(p[1]);
+    }
+
+    ::close(sp[0]);
+    ::close(sp[1]);
+}
+
+#else
+
+int main() {}
+
+#endif
@@ -0,0 +1,32 @@
+#include "check.h"
+#include <cocls/future.h>
+
+#include <algorithm>
+#include <vector>
+
+int main() {
+    //long chain of callbacks, each callback resolves next promise
+    constexpr int count = 1000000;
+    std::vector<cocls::promise<int> > promises;
+    promises.reserve(count);
+    int nest = 0;
+    int max_nest = 0;
+    int called = 0;
+    int last = 0;
+    for (int i = 0; i < count; i++) {
+        promises.push_back(cocls::make_promise<int>([&, i](cocls::future<int> &f) {
+            ++nest;
+            max_nest = std::max(max_nest, nest);
+            ++called;
+            int v = f.value();
+            if (i + 1 < count) promises[i + 1](v + 1);
+            else last = v;
+            --nest;
+        }));
+    }
+    promises[0](0);
+    CHECK_EQUAL(called, count);
+    CHECK_EQUAL(last, count - 1);
+    CHECK_LESS_EQUAL(max_nest, COCLS_MAX_RESUME_DEPTH);
+    CHECK_EQUAL(nest, 0);
+}
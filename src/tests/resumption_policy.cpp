@@ -0,0 +1,113 @@
+#include "check.h"
+#include <cocls/async.h>
+#include <cocls/future.h>
+#include <cocls/strand.h>
+#include <cocls/thread_pool.h>
+
+#include <string>
+#include <thread>
+
+namespace policy = cocls::resumption_policy;
+
+cocls::thread_pool pool(4);
+cocls::strand str(pool);
+cocls::thread_pool stopped_pool(1);
+
+std::string order;
+
+cocls::async<void> other() {
+    order.push_back('o');
+    co_return;
+}
+
+template<typename Policy>
+cocls::async<int, Policy> child() {
+    order.push_back('b');
+    other().detach();
+    co_return 42;
+}
+
+template<typename Policy>
+cocls::async<int> parent() {
+    order.push_back('a');
+    int v = co_await child<Policy>();
+    order.push_back('c');
+    co_return v;
+}
+
+cocls::async<int, policy::executor<pool> > in_pool() {
+    co_return 1;
+}
+
+cocls::async<std::thread::id> await_in_pool() {
+    int v = co_await in_pool();
+    CHECK_EQUAL(v, 1);
+    co_return std::this_thread::get_id();
+}
+
+cocls::async<int, policy::executor<stopped_pool> > in_stopped_pool() {
+    co_return 2;
+}
+
+cocls::async<int> await_in_stopped_pool() {
+    int v = co_await in_stopped_pool();
+    co_return v + 1;
+}
+
+cocls::async<void, policy::executor<str> > in_strand() {
+    co_return;
+}
+
+cocls::async<void> await_in_strand(int &counter, bool &serialized) {
+    co_await pool;
+    co_await in_strand();
+    serialized = serialized && str.is_current();
+    ++counter;
+}
+
+int main() {
+    {
+        //immediate - awaiting coroutine skips the queue
+        order.clear();
+        int v = parent<policy::immediate>().join();
+        CHECK_EQUAL(v, 42);
+        CHECK_EQUAL(order, "abco");
+    }
+    {
+        //queued - awaiting coroutine is resumed after coroutines already in the queue
+        order.clear();
+        int v = parent<policy::queued>().join();
+        CHECK_EQUAL(v, 42);
+        CHECK_EQUAL(order, "aboc");
+    }
+    {
+        //executor - awaiting coroutine continues in the thread pool
+        std::thread::id id = await_in_pool().join();
+        CHECK_NOT_EQUAL(id, std::this_thread::get_id());
+        //also when the future is awaited synchronously
+        int v = cocls::future<int>(in_pool()).wait();
+        CHECK_EQUAL(v, 1);
+    }
+    {
+        //executor is stopped - the coroutine is finished in the current thread
+        stopped_pool.stop();
+        int v = cocls::future<int>(in_stopped_pool()).wait();
+        CHECK_EQUAL(v, 2);
+        int w = await_in_stopped_pool().join();
+        CHECK_EQUAL(w, 3);
+    }
+    {
+        //strand - awaiting coroutines are serialized
+        constexpr int count = 100;
+        int counter = 0;
+        bool serialized = true;
+        cocls::future<void> fs[count];
+        for (auto &f: fs) {
+            auto p = f.get_promise();
+            await_in_strand(counter, serialized).start(p);
+        }
+        for (auto &f: fs) f.wait();
+        CHECK(serialized);
+        CHECK_EQUAL(counter, count);
+    }
+}
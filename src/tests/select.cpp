@@ -0,0 +1,197 @@
+#include "check.h"
+#include <cocls/channel.h>
+#include <cocls/select.h>
+#include <cocls/thread_pool.h>
+
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+cocls::async<int> select_signal(cocls::signal<int>::emitter em, cocls::queue<int> &q) {
+    auto r = co_await cocls::select(cocls::pop_case(q), cocls::signal_case<int>(em));
+    co_return r.index() == 1?std::get<1>(r):-1;
+}
+
+cocls::async<int> select_void_signal(cocls::signal<void>::emitter em, cocls::queue<int> &q) {
+    try {
+        auto r = co_await cocls::select(cocls::pop_case(q), cocls::signal_case<void>(em));
+        co_return static_cast<int>(r.index());
+    } catch (const cocls::await_canceled_exception &) {
+        co_return -1;
+    }
+}
+
+cocls::async<int> channel_receiver(cocls::channel<int> &ch, int count) {
+    int sum = 0;
+    for (int i = 0; i < count; i++) {
+        int v = co_await ch.recv();
+        sum += v;
+    }
+    co_return sum;
+}
+
+int main() {
+    cocls::thread_pool pool(4);
+    cocls::scheduler sch(pool);
+
+    {
+        //ready case is selected immediately, the other one is not armed
+        cocls::queue<int> q1, q2;
+        q2.push(2);
+        auto r = cocls::select(cocls::pop_case(q1), cocls::pop_case(q2)).wait();
+        CHECK_EQUAL(r.index(), 1u);
+        CHECK_EQUAL(std::get<1>(r), 2);
+    }
+    {
+        //value pushed later, losing queue keeps no waiter
+        cocls::queue<int> q1, q2;
+        std::thread thr([&]{
+            std::this_thread::sleep_for(10ms);
+            q2.push(42);
+        });
+        auto r = cocls::select(cocls::pop_case(q1), cocls::pop_case(q2)).wait();
+        thr.join();
+        CHECK_EQUAL(r.index(), 1u);
+        CHECK_EQUAL(std::get<1>(r), 42);
+        q1.push(1);
+        auto sz = q1.size();
+        CHECK_EQUAL(sz, 1u);
+    }
+    {
+        //timeout
+        cocls::queue<int> q;
+        auto r = cocls::select(cocls::pop_case(q), cocls::timeout_case(sch, 20ms)).wait();
+        CHECK_EQUAL(r.index(), 1u);
+        q.push(1);
+        auto sz = q.size();
+        CHECK_EQUAL(sz, 1u);
+        //timeout is canceled when other case is selected
+        auto r2 = cocls::select(cocls::pop_case(q), cocls::timeout_case(sch, 10s)).wait();
+        CHECK_EQUAL(r2.index(), 0u);
+        CHECK_EQUAL(std::get<0>(r2), 1);
+    }
+    {
+        //select in a deep chain of callbacks, canceled timeout is deferred by this thread
+        constexpr int depth = COCLS_MAX_RESUME_DEPTH * 2;
+        std::vector<cocls::promise<int> > promises;
+        std::size_t idx = 0;
+        for (int i = 0; i < depth; i++) {
+            promises.push_back(cocls::make_promise<int>([&, i](cocls::future<int> &) {
+                if (i + 1 < depth) {
+                    promises[i + 1](0);
+                } else {
+                    cocls::queue<int> q;
+                    q.push(1);
+                    auto r = cocls::select(cocls::timeout_case(sch, 10s), cocls::pop_case(q)).wait();
+                    idx = r.index();
+                }
+            }));
+        }
+        promises[0](0);
+        CHECK_EQUAL(idx, 1u);
+    }
+    {
+        //signal
+        cocls::signal<int> sig;
+        cocls::queue<int> q;
+        auto f = select_signal(sig.get_emitter(), q).start();
+        sig.get_collector()(42);
+        int v = f.wait();
+        CHECK_EQUAL(v, 42);
+        q.push(1);
+        auto sz = q.size();
+        CHECK_EQUAL(sz, 1u);
+    }
+    {
+        //signal is destroyed while the select is armed
+        cocls::queue<int> q;
+        std::optional<cocls::signal<void> > sig(std::in_place);
+        auto f = select_void_signal(sig->get_emitter(), q).start();
+        sig.reset();
+        int v = f.wait();
+        CHECK_EQUAL(v, -1);
+    }
+    {
+        //limited queue, push is not duplicated when the queue is full
+        cocls::limited_queue<int> lq(2);
+        lq.push(1).wait();
+        lq.push(2).wait();
+        auto blocked = lq.push(3);
+        int v1 = lq.pop().wait();
+        CHECK_EQUAL(v1, 1);
+        blocked.wait();
+        int v2 = lq.pop().wait();
+        CHECK_EQUAL(v2, 2);
+        int v3 = lq.pop().wait();
+        CHECK_EQUAL(v3, 3);
+        auto sz = lq.size();
+        CHECK_EQUAL(sz, 0u);
+
+        //select push
+        lq.push(10).wait();
+        lq.push(11).wait();
+        auto r = cocls::select(cocls::push_case(lq, 12), cocls::timeout_case(sch, 20ms)).wait();
+        CHECK_EQUAL(r.index(), 1u);
+        int v4 = lq.pop().wait();
+        CHECK_EQUAL(v4, 10);
+        auto r2 = cocls::select(cocls::push_case(lq, 13), cocls::timeout_case(sch, 10s)).wait();
+        CHECK_EQUAL(r2.index(), 0u);
+        int v5 = lq.pop().wait();
+        CHECK_EQUAL(v5, 11);
+        int v6 = lq.pop().wait();
+        CHECK_EQUAL(v6, 13);
+    }
+    {
+        //select waiting for space in limited queue
+        cocls::limited_queue<int> lq(1);
+        lq.push(1).wait();
+        std::thread thr([&]{
+            std::this_thread::sleep_for(10ms);
+            int v = lq.pop().wait();
+            CHECK_EQUAL(v, 1);
+        });
+        auto r = cocls::select(cocls::push_case(lq, 2), cocls::timeout_case(sch, 10s)).wait();
+        thr.join();
+        CHECK_EQUAL(r.index(), 0u);
+        int v7 = lq.pop().wait();
+        CHECK_EQUAL(v7, 2);
+    }
+    {
+        //rendezvous channel
+        cocls::channel<int> ch;
+        auto f = channel_receiver(ch, 100).start();
+        for (int i = 1; i <= 100; i++) ch.send(i).wait();
+        int v8 = f.wait();
+        CHECK_EQUAL(v8, 5050);
+    }
+    {
+        //two selects paired with each other through channels in both directions
+        cocls::channel<int> ch1, ch2;
+        std::atomic<int> a_sent = 0, b_sent = 0;
+        constexpr int count = 2000;
+        std::thread thr([&]{
+            for (int i = 0; i < count; i++) {
+                auto r = cocls::select(cocls::recv_case(ch1), cocls::send_case(ch2, 2)).wait();
+                if (r.index() == 0) {
+                    CHECK_EQUAL(std::get<0>(r), 1);
+                } else {
+                    ++b_sent;
+                }
+            }
+        });
+        for (int i = 0; i < count; i++) {
+            auto r = cocls::select(cocls::send_case(ch1, 1), cocls::recv_case(ch2)).wait();
+            if (r.index() == 0) {
+                ++a_sent;
+            } else {
+                CHECK_EQUAL(std::get<1>(r), 2);
+            }
+        }
+        thr.join();
+        int total = a_sent + b_sent;
+        CHECK_EQUAL(total, count);
+    }
+}
@@ -0,0 +1,91 @@
+#include "check.h"
+#include <cocls/future.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+static std::atomic<int> allocations = 0;
+
+void *operator new(std::size_t sz) {
+    ++allocations;
+    void *p = std::malloc(sz?sz:1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void run_callbacks(int count, int &sum) {
+    for (int i = 0; i < count; i++) {
+        auto p = cocls::make_promise<int>([&](cocls::future<int> &f) {
+            sum += f.value();
+        });
+        p(i);
+        cocls::discard([]{return cocls::future<int>([](auto p){p(1);});});
+    }
+}
+
+int main() {
+    int sum = 0;
+    //warm up caches
+    run_callbacks(1, sum);
+    int before = allocations;
+    run_callbacks(1000, sum);
+    int after = allocations;
+    //steady state doesn't allocate
+    CHECK_EQUAL(before, after);
+    CHECK_EQUAL(sum, 499500);
+
+    {
+        //blocks are reused and released by other thread
+        cocls::slab_storage &s = cocls::slab_storage::instance;
+        void *a = s.alloc(40);
+        cocls::slab_storage::dealloc(a, 40);
+        void *b = s.alloc(48);
+        CHECK_EQUAL(a, b);
+        std::thread thr([&]{cocls::slab_storage::dealloc(b, 48);});
+        thr.join();
+        void *c = s.alloc(1000);
+        cocls::slab_storage::dealloc(c, 1000);
+    }
+    {
+        //blocks released by other thread return to this thread through the shared list
+        constexpr int count = 100;
+        void *blocks[count];
+        std::atomic<int> round = 0;
+        std::atomic<int> done = 0;
+        std::thread thr([&]{
+            for (int r = 1; r <= 40; r++) {
+                while (round != r) std::this_thread::yield();
+                for (void *b: blocks) cocls::slab_storage::dealloc(b, 40);
+                done = r;
+            }
+        });
+        int steady = 0;
+        for (int r = 1; r <= 40; r++) {
+            if (r == 21) steady = allocations;
+            for (void *&b: blocks) b = cocls::slab_storage::instance.alloc(40);
+            round = r;
+            while (done != r) std::this_thread::yield();
+        }
+        int after = allocations;
+        thr.join();
+        CHECK_EQUAL(steady, after);
+    }
+    {
+        //explicit storage
+        auto p = cocls::make_promise<int>([&](cocls::future<int> &f) {
+            sum = f.value();
+        }, cocls::slab_storage::instance);
+        p(42);
+        CHECK_EQUAL(sum, 42);
+    }
+}
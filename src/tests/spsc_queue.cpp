@@ -0,0 +1,66 @@
+#include "check.h"
+#include <cocls/spsc_queue.h>
+#include <cocls/thread_pool.h>
+
+#include <thread>
+
+cocls::async<long> consumer(cocls::thread_pool &pool, cocls::spsc_queue<int> &q, int count, bool &ordered) {
+    co_await pool;
+    long sum = 0;
+    int prev = 0;
+    for (int i = 0; i < count; i++) {
+        int v = co_await q.pop();
+        if (v != prev + 1) ordered = false;
+        prev = v;
+        sum += v;
+    }
+    co_return sum;
+}
+
+int main() {
+    {
+        cocls::spsc_queue<int> q(3);
+        CHECK_EQUAL(q.capacity(), 4u);
+        for (int i = 0; i < 4; i++) {
+            bool ok = q.try_push(i);
+            CHECK(ok);
+        }
+        bool full = q.try_push(4);
+        CHECK(!full);
+        CHECK_EQUAL(q.size(), 4u);
+        auto v = q.try_pop();
+        CHECK(v.has_value());
+        CHECK_EQUAL(*v, 0);
+        int w = q.pop().wait();
+        CHECK_EQUAL(w, 1);
+    }
+    {
+        //producer thread, consumer coroutine in the pool
+        constexpr int count = 200000;
+        cocls::thread_pool pool(2);
+        cocls::spsc_queue<int> q(64);
+        bool ordered = true;
+        auto f = consumer(pool, q, count, ordered).start();
+        for (int i = 1; i <= count; i++) {
+            while (!q.try_push(i)) std::this_thread::yield();
+        }
+        long sum = f.wait();
+        CHECK_EQUAL(sum, static_cast<long>(count) * (count + 1) / 2);
+        CHECK(ordered);
+        CHECK(q.empty());
+    }
+    {
+        //synchronous consumer
+        constexpr int count = 100000;
+        cocls::spsc_queue<std::unique_ptr<int> > q(16);
+        std::thread thr([&]{
+            for (int i = 1; i <= count; i++) {
+                while (!q.try_push(std::make_unique<int>(i))) std::this_thread::yield();
+            }
+        });
+        long sum = 0;
+        for (int i = 0; i < count; i++) sum += *q.pop().wait();
+        thr.join();
+        CHECK_EQUAL(sum, static_cast<long>(count) * (count + 1) / 2);
+    }
+}
@@ -0,0 +1,70 @@
+#include "check.h"
+#include <cocls/strand.h>
+
+#include <vector>
+
+cocls::async<void> touch(cocls::strand &s, cocls::thread_pool &pool, int &counter,
+                         std::atomic<int> &inside, std::atomic<int> &violations) {
+    co_await pool;
+    for (int i = 0; i < 10; i++) {
+        co_await s;
+        if (inside.fetch_add(1) != 0) ++violations;
+        if (!s.is_current()) ++violations;
+        ++counter;
+        std::this_thread::yield();
+        inside.fetch_sub(1);
+        //leave the strand
+        co_await pool;
+    }
+}
+
+cocls::async<void> record(cocls::strand &s, std::vector<int> &order, int i) {
+    co_await s;
+    order.push_back(i);
+}
+
+int main() {
+    cocls::thread_pool pool(4);
+
+    {
+        cocls::strand s(pool);
+        int counter = 0;
+        std::atomic<int> inside = 0;
+        std::atomic<int> violations = 0;
+        std::vector<cocls::future<void> > res(100);
+        for (auto &f: res) {
+            f << [&]() -> cocls::future<void> {return touch(s, pool, counter, inside, violations);};
+        }
+        for (auto &f: res) f.wait();
+        CHECK_EQUAL(counter, 1000);
+        CHECK_EQUAL(violations.load(), 0);
+        CHECK(!s.is_current());
+    }
+
+    {
+        //coroutines are processed in order of arrival
+        cocls::strand s(pool);
+        std::vector<int> order;
+        std::vector<cocls::future<void> > res(200);
+        for (int i = 0; i < 200; i++) {
+            res[i] << [&]() -> cocls::future<void> {return record(s, order, i);};
+        }
+        for (auto &f: res) f.wait();
+        bool sorted = std::is_sorted(order.begin(), order.end());
+        CHECK_EQUAL(order.size(), 200u);
+        CHECK(sorted);
+    }
+
+    {
+        //strand is destroyed right after its last coroutine finishes, the destructor
+        //waits until the task of the strand leaves it
+        std::vector<int> order;
+        for (int i = 0; i < 500; i++) {
+            cocls::strand s(pool);
+            cocls::future<void> f;
+            f << [&]() -> cocls::future<void> {return record(s, order, i);};
+            f.wait();
+        }
+        CHECK_EQUAL(order.size(), 500u);
+    }
+}
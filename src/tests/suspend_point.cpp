@@ -26,6 +26,24 @@ int main() {
     run_sp(std::move(sp1));
     CHECK_EQUAL(counter, 12);
 
+    //merge heap backed suspend points (splice)
+    for (int j = 0; j < 3; j++) {
+        cocls::suspend_point<void> sp2;
+        cocls::suspend_point<void> sp3;
+        for (int i = 0; i < 20; i++) {
+            sp2<<coro_test(counter).detach();
+        }
+        for (int i = 0; i < 2+j*10; i++) {
+            sp3<<coro_test(counter).detach();
+        }
+        sp3 << std::move(sp2);
+        CHECK_EQUAL(sp2.size(), 0);
+        CHECK_EQUAL(sp3.size(), static_cast<std::size_t>(22+j*10));
+        sp1 << std::move(sp3);
+        run_sp(std::move(sp1));
+    }
+    CHECK_EQUAL(counter, 12+22+32+42);
+
 
     return 0;
 }
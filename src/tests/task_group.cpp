@@ -0,0 +1,99 @@
+#include "check.h"
+#include <cocls/task_group.h>
+#include <cocls/with_allocator.h>
+
+#include <stdexcept>
+
+cocls::async<void> worker(cocls::thread_pool &pool, std::atomic<int> &active, std::atomic<int> &max_active, std::atomic<int> &done) {
+    co_await pool;
+    int a = ++active;
+    int m = max_active;
+    while (a > m && !max_active.compare_exchange_weak(m, a));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    --active;
+    ++done;
+}
+
+cocls::async<void> thrower(std::atomic<int> &started) {
+    ++started;
+    throw std::runtime_error("failed");
+    co_return;
+}
+
+cocls::async<void> cooperative(std::stop_token tkn, std::atomic<bool> &stopped) {
+    while (!tkn.stop_requested()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    stopped = true;
+    co_return;
+}
+
+cocls::with_allocator<cocls::task_group_arena, cocls::async<void> > child(cocls::task_group_arena &, cocls::future<int> &f, int &sum) {
+    sum += co_await f;
+}
+
+cocls::async<int> parent(cocls::future<int> *futures, int count) {
+    cocls::task_group grp(2);
+    int sum = 0;
+    for (int i = 0; i < count; i++) {
+        grp.spawn(child(grp.get_arena(), futures[i], sum));
+    }
+    co_await grp;
+    co_return sum;
+}
+
+int main() {
+    {
+        cocls::thread_pool pool(4);
+        std::atomic<int> active = 0, max_active = 0, done = 0;
+        cocls::task_group grp(pool, 2);
+        for (int i = 0; i < 10; i++) grp.spawn(worker(pool, active, max_active, done));
+        grp.join().wait();
+        CHECK_EQUAL(done.load(), 10);
+        CHECK_LESS_EQUAL(max_active.load(), 2);
+        CHECK_EQUAL(grp.running(), 0);
+    }
+
+    {
+        cocls::thread_pool pool(2);
+        std::atomic<int> started = 0;
+        cocls::task_group grp(pool, 1);
+        for (int i = 0; i < 5; i++) grp.spawn(thrower(started));
+        CHECK_EXCEPTION(std::runtime_error, grp.join().wait());
+        CHECK_EQUAL(started.load(), 1);
+        CHECK(grp.get_token().stop_requested());
+        CHECK_EQUAL(grp.pending(), 0);
+    }
+
+    {
+        cocls::thread_pool pool(2);
+        std::atomic<int> started = 0;
+        std::atomic<bool> stopped = false;
+        cocls::task_group grp(pool);
+        grp.spawn(cooperative(grp.get_token(), stopped));
+        grp.spawn(thrower(started));
+        CHECK_EXCEPTION(std::runtime_error, grp.join().wait());
+        CHECK(stopped.load());
+    }
+
+    {
+        cocls::future<int> futures[5];
+        cocls::promise<int> promises[5];
+        for (int i = 0; i < 5; i++) promises[i] = futures[i].get_promise();
+        auto res = parent(futures, 5).start();
+        for (int i = 0; i < 5; i++) promises[i](i + 1);
+        int sum = res.wait();
+        CHECK_EQUAL(sum, 15);
+    }
+
+    {
+        //destructor waits for running children
+        cocls::thread_pool pool(2);
+        std::atomic<int> active = 0, max_active = 0, done = 0;
+        {
+            cocls::task_group grp(pool, 3);
+            for (int i = 0; i < 3; i++) grp.spawn(worker(pool, active, max_active, done));
+        }
+        CHECK_EQUAL(done.load(), 3);
+    }
+}
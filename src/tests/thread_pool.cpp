@@ -69,6 +69,31 @@ int main(int, char **) {
 
     }
 
+    {
+        //idle workers are parked after spinning, tasks still wake them up
+        cocls::thread_pool pool2(2, {16, 1});
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CHECK_EQUAL(pool2.get_sleepers(), 2);
+        for (int i = 0; i < 100; i++) {
+            int v = pool2.run([i]{return i;}).join();
+            CHECK_EQUAL(v, i);
+        }
+        //without spinning
+        pool2.set_idle_policy({0, 0});
+        CHECK_EQUAL(pool2.get_idle_policy().spin_count, 0u);
+        auto id1 = pool2.run(get_id_coro()).join();
+        CHECK_NOT_EQUAL(id1, std::this_thread::get_id());
+        //synchronous wait without spinning parks immediately
+        auto sp = cocls::sync_awaiter::get_idle_policy();
+        cocls::sync_awaiter::set_idle_policy({0, 0});
+        int v = pool2.run([]{
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            return 1;
+        }).join();
+        CHECK_EQUAL(v, 1);
+        cocls::sync_awaiter::set_idle_policy(sp);
+    }
+
 
 
 
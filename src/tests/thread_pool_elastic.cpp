@@ -0,0 +1,55 @@
+#include "check.h"
+#include <cocls/thread_pool.h>
+
+#include <vector>
+
+int main() {
+    cocls::thread_pool::elastic_config cfg;
+    cfg.min_threads = 1;
+    cfg.max_threads = 4;
+    cfg.spawn_latency = std::chrono::milliseconds(2);
+    cfg.idle_timeout = std::chrono::milliseconds(50);
+    cocls::thread_pool pool(cfg);
+    CHECK_EQUAL(pool.get_thread_count(), 1u);
+
+    {
+        //blocking tasks cause that new threads are started
+        auto start = std::chrono::steady_clock::now();
+        std::vector<cocls::future<int> > results(4);
+        for (int i = 0; i < 4; i++) {
+            results[i] << [&, i]{
+                return pool.run([i]{
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    return i;
+                });
+            };
+        }
+        int sum = 0;
+        for (auto &f: results) sum += f.wait();
+        auto dur = std::chrono::steady_clock::now() - start;
+        CHECK_EQUAL(sum, 6);
+        CHECK_LESS(dur, std::chrono::milliseconds(350));
+        auto st = pool.get_elastic_stats();
+        CHECK_GREATER(st.peak_threads, 1u);
+        CHECK_LESS_EQUAL(st.peak_threads, 4u);
+        CHECK_GREATER(st.spawned, 0u);
+    }
+
+    {
+        //idle threads are retired up to the minimum
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        auto st = pool.get_elastic_stats();
+        CHECK_EQUAL(st.threads, 1u);
+        CHECK_EQUAL(st.retired, st.spawned);
+        int v = pool.run([]{return 42;}).wait();
+        CHECK_EQUAL(v, 42);
+    }
+
+    {
+        //fixed pool reports its size
+        cocls::thread_pool fixed(3);
+        auto st = fixed.get_elastic_stats();
+        CHECK_EQUAL(st.threads, 3u);
+        CHECK_EQUAL(st.spawned, 0u);
+    }
+}
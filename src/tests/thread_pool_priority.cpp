@@ -0,0 +1,75 @@
+#include "check.h"
+#include <cocls/thread_pool.h>
+
+#include <mutex>
+#include <string>
+
+using prio = cocls::thread_pool::priority;
+
+//runs tasks in single thread, records order of execution
+std::string run_order(cocls::thread_pool &pool, const std::string &tasks) {
+    std::mutex mx;
+    std::string order;
+    std::atomic<bool> gate = false;
+    //block the worker, so all tasks are enqueued before they are dispatched
+    pool.run_detached([&]{gate.wait(false);});
+    for (char c: tasks) {
+        prio p = c == 'C'?prio::critical:c == 'B'?prio::background:prio::normal;
+        pool.run_detached([&, c]{
+            std::lock_guard _(mx);
+            order.push_back(c);
+        }, p);
+    }
+    gate = true;
+    gate.notify_all();
+    while (pool.any_enqueued()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    pool.run([]{}, prio::background).wait();
+    return order;
+}
+
+cocls::async<std::thread::id> in_pool(cocls::thread_pool &pool) {
+    co_await pool.with_priority(prio::critical);
+    co_return std::this_thread::get_id();
+}
+
+int main() {
+    {
+        cocls::thread_pool pool(1);
+        cocls::thread_pool::dispatch_config cfg;
+        cfg.aging = 0;
+        pool.set_dispatch(cfg);
+        std::string order = run_order(pool, "BBBNNCC");
+        CHECK_EQUAL(order, "CCNNBBB");
+    }
+
+    {
+        cocls::thread_pool pool(1);
+        cocls::thread_pool::dispatch_config cfg;
+        cfg.mode = cocls::thread_pool::dispatch_mode::weighted;
+        cfg.weights[0] = 2;
+        cfg.weights[3] = 1;
+        cfg.aging = 0;
+        pool.set_dispatch(cfg);
+        std::string order = run_order(pool, "BBBCCCCCC");
+        CHECK_EQUAL(order, "CCBCCBCCB");
+    }
+
+    {
+        cocls::thread_pool pool(1);
+        cocls::thread_pool::dispatch_config cfg;
+        cfg.aging = 3;
+        pool.set_dispatch(cfg);
+        std::string order = run_order(pool, "BCCCCCC");
+        //background task waits while 3 other tasks are dispatched
+        CHECK_EQUAL(order, "CCCBCCC");
+    }
+
+    {
+        cocls::thread_pool pool(2);
+        auto id = in_pool(pool).join();
+        CHECK_NOT_EQUAL(id, std::this_thread::get_id());
+        int v = pool.run([]{return 7;}, prio::high).wait();
+        CHECK_EQUAL(v, 7);
+        CHECK_EQUAL(pool.get_enqueued(prio::high), 0u);
+    }
+}
@@ -0,0 +1,64 @@
+#define COCLS_TRACING
+#include "check.h"
+#include <cocls/async.h>
+#include <cocls/future.h>
+#include <cocls/thread_pool.h>
+
+#include <sstream>
+
+using namespace cocls::tracing;
+
+cocls::async<int> waiter(cocls::future<int> &f) {
+    int v = co_await f;
+    co_return v;
+}
+
+cocls::async<void> in_pool(cocls::thread_pool &pool) {
+    co_await pool;
+}
+
+std::size_t count(const std::vector<thread_trace> &traces, event e) {
+    std::size_t n = 0;
+    for (const auto &t: traces) {
+        for (const auto &r: t.events) n += r.type == e;
+    }
+    return n;
+}
+
+int main() {
+    {
+        cocls::future<int> f;
+        cocls::promise<int> p = f.get_promise();
+        auto res = waiter(f).start();
+        p(42);
+        int v = res.wait();
+        CHECK_EQUAL(v, 42);
+        auto traces = collect();
+        CHECK_EQUAL(traces.size(), 1);
+        CHECK_GREATER_EQUAL(count(traces, event::suspend), 1u);
+        CHECK_GREATER_EQUAL(count(traces, event::resume), 1u);
+        CHECK_GREATER_EQUAL(count(traces, event::finish), 1u);
+        //events are ordered
+        const auto &ev = traces[0].events;
+        CHECK(std::is_sorted(ev.begin(), ev.end(), [](const record &a, const record &b){
+            return a.timestamp < b.timestamp;
+        }));
+    }
+
+    {
+        cocls::thread_pool pool(2);
+        for (int i = 0; i < 3000; i++) in_pool(pool).join();
+        auto traces = collect();
+        CHECK_GREATER_EQUAL(traces.size(), 2u);
+        CHECK_GREATER_EQUAL(count(traces, event::enqueue), 3000u);
+        for (const auto &t: traces) {
+            CHECK_LESS_EQUAL(t.events.size(), static_cast<std::size_t>(COCLS_TRACING_RING_SIZE));
+        }
+    }
+
+    std::ostringstream out;
+    dump_chrome_trace(out);
+    std::string s = out.str();
+    CHECK(s.starts_with("{\"traceEvents\":["));
+    CHECK(s.find("\"name\":\"finish\",\"ph\":\"i\"") != s.npos);
+}